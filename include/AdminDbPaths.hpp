@@ -5,4 +5,5 @@
 namespace AdminDbPaths {
   QStringList allCsvPaths();                 // 5 csv files
   QString pathForKey(const QString& key);    // "MATERIAL" -> "data/material.csv"
+  QString pagedStorePath();                  // "data/admin.pdb": all tables, paged storage builds
 }
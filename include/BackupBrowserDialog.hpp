@@ -0,0 +1,33 @@
+#pragma once
+#include <QDialog>
+#include <QTemporaryDir>
+
+class QTableWidget;
+class QTableView;
+class QLabel;
+class QPushButton;
+class CsvTableModel;
+
+// Backups of one CSV, newest first. Selecting one previews it read-only: the version is
+// rebuilt into a temporary file and mapped, so only the rows on screen are ever decoded.
+// Accepting the dialog asks for the selected backup to be restored.
+class BackupBrowserDialog : public QDialog {
+  Q_OBJECT
+public:
+  explicit BackupBrowserDialog(const QString& csvPath, QWidget* parent = nullptr);
+
+  QString selectedManifest() const { return selected_; }
+
+private:
+  void preview(int row);
+
+  QString csvPath_;
+  QString selected_;
+
+  QTableWidget* list_ = nullptr;
+  QTableView* preview_ = nullptr;
+  CsvTableModel* model_ = nullptr;
+  QLabel* status_ = nullptr;
+  QPushButton* restoreBtn_ = nullptr;
+  QTemporaryDir previewDir_;
+};
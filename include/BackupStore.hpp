@@ -0,0 +1,37 @@
+#pragma once
+#include <QDateTime>
+#include <QString>
+#include <QVector>
+
+// Deduplicated backups next to the backed-up files, in <dir>/.backups/:
+//   chunks/<2 hex>/<sha256 hex>.z       content-defined chunks, zlib-compressed, each stored once
+//   manifests/<file name>/<time>.json   one per backup: size, whole-file hash, and the chunk list,
+//                                       as a delta against the previous backup's (full every 16th)
+//   manifests/<file name>.idx           that file's backups in order, with their metadata
+//   chunks.refs                         how many backups refer to each chunk
+// Chunk boundaries follow the content (gear rolling hash), so an edit only produces new
+// chunks around itself: what a backup writes grows with the edit, not with the table.
+namespace BackupStore {
+  struct Entry {
+    QString manifestPath;
+    QDateTime created;
+    qint64 size = 0;
+    qint64 rows = -1; // data rows of a CSV, -1 for other files
+    QString sha256;
+    int depth = 0;    // deltas since the last full chunk list
+  };
+
+  QString storeDirFor(const QString& path);
+
+  // Backups of `path`, newest first, from its index
+  QVector<Entry> list(const QString& path);
+
+  // Records the current content of `path`, unless the newest backup already has it.
+  // Keeps the newest keepN backups of this file; chunks no backup refers to are deleted.
+  // Any thread; backups of one store are serialized.
+  bool backup(const QString& path, int keepN, QString* error = nullptr);
+
+  // Rebuilds the backup `manifestPath` into `targetPath` (replaced atomically, only if the
+  // rebuilt bytes match the recorded hash)
+  bool restore(const QString& manifestPath, const QString& targetPath, QString* error = nullptr);
+}
@@ -5,4 +5,5 @@ class QWidget;
 
 namespace BackupUtils {
   bool makeTimestampedBackupKeepN(const QString& path, QWidget* parent, int keepN);
+  bool makeTimestampedBackupKeepN(const QString& path, int keepN, QString* error); // no UI, any thread
 }
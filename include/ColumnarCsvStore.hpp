@@ -0,0 +1,60 @@
+#pragma once
+#include "CsvBackingStore.hpp"
+#include "CsvTokenizer.hpp"
+
+#include <QByteArray>
+#include <memory>
+
+// Fully decoded table held column by column (small files, setTable).
+// Text columns are one UTF-8 arena plus offsets; a column whose every cell is a number that
+// prints back unchanged is stored as doubles plus a null bitmap, so saving stays byte-exact.
+// Text columns that repeat a few values (material names, machine families) become u16 codes
+// into a dictionary of shared strings.
+class ColumnarCsvStore : public CsvBackingStore {
+public:
+  // Header record 0 plus data records [1, rows]; cells come straight from the source bytes
+  static std::shared_ptr<ColumnarCsvStore> fromIndex(const char* data, const CsvTokenizer::Index& idx, qsizetype rows);
+  static std::shared_ptr<ColumnarCsvStore> fromRows(const QStringList& headers, const QVector<QStringList>& rows);
+
+  QStringList headers() const override { return headers_; }
+  int rowCount() const override { return rows_; }
+  int columnCount() const override { return headers_.size(); }
+  QString cell(int row, int col) const override;
+  void writeCell(int row, int col, CsvCellSink& sink) const override;
+
+  const QStringList* dictionary(int col) const override;
+  int dictionaryCode(int row, int col) const override;
+
+  bool isNumeric(int col) const { return col >= 0 && col < columns_.size() && columns_[col].kind == Kind::Numeric; }
+  bool number(int row, int col, double& out) const override; // false for other columns and empty cells
+  bool viewUtf8(int row, int col, QByteArrayView& out) const override; // text columns
+
+  qint64 memoryBytes() const override;
+
+private:
+  enum class Kind : quint8 { Text, Numeric, Dictionary };
+
+  struct Column {
+    Kind kind = Kind::Text;
+    QByteArray arena;             // text: cells back to back
+    QVector<quint32> offsets;     // text: rows + 1
+    QVector<double> values;       // numeric
+    QVector<quint64> present;     // numeric: one bit per row, clear = empty cell
+    QVector<quint16> codes;       // dictionary: one per row
+    QStringList dictionary;       // dictionary: shared values, cell() hands out copies without allocating
+    QVector<QByteArray> dictUtf8; // dictionary: same values for writeCell
+  };
+
+  ColumnarCsvStore() = default;
+
+  // appendCell(arena, row, col) adds one cell's UTF-8; columns are filled and typed in parallel
+  template <typename AppendCell>
+  void build(int rows, AppendCell&& appendCell);
+  static void typeColumn(Column& c, int rows);
+  static bool makeNumeric(Column& c, int rows);
+  static bool makeDictionary(Column& c, int rows);
+
+  QStringList headers_;
+  QVector<Column> columns_;
+  int rows_ = 0;
+};
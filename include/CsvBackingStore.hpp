@@ -0,0 +1,42 @@
+#pragma once
+#include <QByteArrayView>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+
+// Receives cells in the form they are stored in, so writers never build whole rows
+class CsvCellSink {
+public:
+  virtual ~CsvCellSink() = default;
+
+  virtual void text(QStringView field) = 0;    // decoded / edited cells
+  virtual void utf8(QByteArrayView field) = 0; // unescaped UTF-8 straight from a mapped store
+  virtual void endRecord() = 0;
+};
+
+// Read-only table content behind CsvTableModel, addressed by load-time row/column ids.
+// Edits never touch a store; the model keeps them in its own overlay.
+class CsvBackingStore {
+public:
+  virtual ~CsvBackingStore() = default;
+
+  virtual QStringList headers() const = 0;
+  virtual int rowCount() const = 0;
+  virtual int columnCount() const = 0;
+  virtual QString cell(int row, int col) const = 0; // empty when the row is shorter
+  virtual void writeCell(int row, int col, CsvCellSink& sink) const { sink.text(cell(row, col)); }
+
+  // Typed numeric columns: false when the store keeps the column (or this cell) as text
+  virtual bool number(int row, int col, double& out) const { Q_UNUSED(row); Q_UNUSED(col); Q_UNUSED(out); return false; }
+
+  // The cell's decoded UTF-8 without copying, when the store holds it that way
+  virtual bool viewUtf8(int row, int col, QByteArrayView& out) const { Q_UNUSED(row); Q_UNUSED(col); Q_UNUSED(out); return false; }
+
+  // Dictionary-encoded columns: every cell is one of a few shared values, addressed by code
+  virtual const QStringList* dictionary(int col) const { Q_UNUSED(col); return nullptr; }
+  virtual int dictionaryCode(int row, int col) const { Q_UNUSED(row); Q_UNUSED(col); return -1; }
+
+  // Roughly what keeping this store costs: heap plus mapped file bytes
+  virtual qint64 memoryBytes() const { return 0; }
+};
+
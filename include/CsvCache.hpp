@@ -0,0 +1,16 @@
+#pragma once
+#include <QString>
+#include <memory>
+
+class CsvBackingStore;
+
+// Binary columnar snapshot next to each CSV (e.g. "data/material.csv.cache"), with the column
+// types a parse finds (numeric, dictionary). Keyed by the CSV's size, mtime and MD5; opening a
+// valid cache only maps it.
+namespace CsvCache {
+  QString cachePathFor(const QString& csvPath);
+
+  std::shared_ptr<const CsvBackingStore> open(const QString& csvPath); // nullptr when missing or stale
+  bool build(const QString& csvPath);                                  // blocking
+  void rebuildInBackground(const QString& csvPath);                    // one build per path at a time
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <QPointer>
+#include <QString>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+class CsvBackingStore;
+
+// Loads one CSV on the thread pool and hands back ever longer prefixes of the table,
+// so the first screen shows long before a big file is fully parsed.
+class CsvLoadJob : public std::enable_shared_from_this<CsvLoadJob> {
+public:
+  struct Update {
+    std::shared_ptr<const CsvBackingStore> store; // same leading rows as the previous update; null = no table
+    int percent = 0;
+    bool final = false;
+    QString error;
+  };
+  using Callback = std::function<void(const Update&)>;
+
+  // onUpdate runs on the GUI thread, and only while `context` is alive and the job is not cancelled
+  static std::shared_ptr<CsvLoadJob> start(const QString& path, QObject* context, Callback onUpdate);
+
+  // Any other source of a whole table (e.g. the paged file): one final update once it returns
+  using Loader = std::function<std::shared_ptr<const CsvBackingStore>(QString* error)>;
+  static std::shared_ptr<CsvLoadJob> startWith(Loader load, QObject* context, Callback onUpdate);
+
+  // Same sources (cache, mapped file, parsed text), blocking
+  static std::shared_ptr<const CsvBackingStore> loadNow(const QString& path, QString* error = nullptr);
+
+  void cancel() { cancelled_ = true; }
+  bool isCancelled() const { return cancelled_; }
+
+private:
+  CsvLoadJob(QObject* context, Callback onUpdate);
+
+  void run(const QString& path);
+  void publish(Update u);
+
+  QPointer<QObject> context_; // only read on the GUI thread
+  Callback onUpdate_;
+  std::atomic_bool cancelled_{false};
+};
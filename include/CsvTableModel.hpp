@@ -2,9 +2,17 @@
 
 #include <QAbstractTableModel>
 #include <QStringList>
+#include <QStringView>
 #include <QVector>
+#include <QHash>
 #include <QSet>
 
+#include <memory>
+
+class CsvBackingStore;
+class CsvCellSink;
+class TrigramIndex;
+
 class CsvTableModel : public QAbstractTableModel {
   Q_OBJECT
 public:
@@ -20,10 +28,56 @@ public:
 
   // Table content
   void clear();
-  void setTable(const QStringList& headers, const QVector<QStringList>& rows);
+  void setTable(const QStringList& headers, QVector<QStringList> rows);
+  void setStore(std::shared_ptr<const CsvBackingStore> store); // lazy: cells decoded on demand
+  void growStore(std::shared_ptr<const CsvBackingStore> store); // longer version of the current store
+
+  // Content at one revision. Every member is implicitly shared, so taking one is cheap and
+  // later edits detach the model instead of touching it; safe to read on another thread.
+  struct Snapshot {
+    std::shared_ptr<const CsvBackingStore> store;
+    QStringList headers;
+    QVector<int> rowIds;
+    QVector<int> colIds;
+    QHash<quint64, QString> overlay;
+    quint64 revision = 0;
+
+    void visitCells(CsvCellSink& sink) const; // header record, then every row, without copying the table
+
+    // Same reads as the model's, at this revision
+    int rowCount() const { return rowIds.size(); }
+    int columnCount() const { return colIds.size(); }
+    QString cellText(int row, int col) const;
+    bool cellNumber(int row, int col, double& out) const;
+    const QStringList* dictionary(int col) const;
+    int dictionaryCode(int row, int col) const;
+  };
 
   QStringList headers() const { return headers_; }
-  QVector<QStringList> rows() const { return rows_; }
+  QString cellText(int row, int col) const;
+  bool cellNumber(int row, int col, double& out) const; // typed value, else the text parsed as a number
+  void visitCells(CsvCellSink& sink) const { snapshot().visitCells(sink); }
+
+  // Dictionary-encoded columns (see CsvBackingStore): lets filters test each distinct value once
+  const QStringList* dictionary(int col) const;   // nullptr when the column is not encoded
+  int dictionaryCode(int row, int col) const;     // -1 when not encoded or the cell was edited
+
+  // Position of every row when ordered by `col`: numbers by value (non-numbers last) for numeric
+  // columns, locale collation for text. Cached per column until its cells or the rows change.
+  QVector<int> sortRanks(int col) const;
+
+  // Trigram index over case-folded cell text, built on a worker thread; edits keep it current
+  void rebuildSearchIndex();
+  // View rows that may contain `needle` (case-insensitive), ascending. False when the index
+  // cannot answer (still building, needle shorter than a trigram): every row must be checked.
+  bool searchCandidates(const QString& needle, QVector<int>& rows) const;
+
+  Snapshot snapshot() const;
+  int rowOfId(int rowId) const; // view row now holding a Snapshot::rowIds entry, -1 once removed
+  quint64 revision() const { return revision_; } // bumped by every content change
+
+  // What keeping this table resident costs, roughly: store, row/column ids, edits, search index
+  qint64 memoryBytes() const;
 
   // Columns
   void addColumn(const QString& name);                 // keeps old behavior (text by default)
@@ -33,18 +87,70 @@ public:
   // Rows
   void addRow();
   void deleteRow(int row);
+  bool insertRows(int row, int count, const QModelIndex& parent = QModelIndex()) override; // empty rows
+  bool removeRows(int row, int count, const QModelIndex& parent = QModelIndex()) override;
+  void removeRows(QVector<int> rows); // any order, duplicates ok; contiguous runs are merged
 
   // Column type schema (stored as lowercase header keys)
+  enum class ColumnType : quint8 { Text, Numeric };
   void setNumericColumns(const QSet<QString>& colsLower);
   QSet<QString> numericColumns() const;
+  ColumnType columnType(int col) const { return colTypes_.value(col, ColumnType::Text); }
+  static bool parseNumber(QStringView s, double& out); // decimal comma or dot (NumberParser)
+
+signals:
+  // Every row removal, as (first, count) runs in the order they were applied (highest first).
+  // Also emitted when many runs were removed under one model reset.
+  void rowRunsRemoved(const QVector<QPair<int, int>>& runs);
 
 private:
+  // Load-time content is read-only in store_; rows/columns are addressed by stable
+  // ids so inserts and deletes never touch it, and edits live in overlay_.
+  std::shared_ptr<const CsvBackingStore> store_;
   QStringList headers_;
-  QVector<QStringList> rows_;
+  QVector<int> rowIds_;             // view row -> row id (ids past the store were added later)
+  QVector<int> colIds_;             // view column -> column id
+  QHash<quint64, QString> overlay_; // edited cells by (row id, column id)
+  int nextRowId_ = 0;
+  int nextColId_ = 0;
+  quint64 revision_ = 0;
+
+  // Sort ranks by column id; valid while rowsVersion_ and that column's edit count are unchanged
+  struct SortCache {
+    quint64 rowsVersion = 0;
+    quint64 colVersion = 0;
+    bool numeric = false;
+    QVector<int> ranks;
+  };
+  quint64 rowsVersion_ = 0;          // bumped when rows are added, removed or reloaded
+  QHash<int, quint64> colVersions_;  // column id -> cell edits
+  mutable QHash<int, SortCache> sortCache_;
+
+  std::shared_ptr<TrigramIndex> searchIndex_;
+  quint64 searchIndexBuild_ = 0;   // newest build; older results are dropped
+  bool searchIndexBuilding_ = false;
+  QSet<int> unindexedRows_;        // row ids edited while the index was building
+
+  const QVector<int>& rowPositions() const; // rowPos_, rebuilt once the rows changed
+  mutable QVector<int> rowPos_;    // row id -> view row (-1 = removed)
+  mutable quint64 rowPosVersion_ = ~quint64(0);
+
+  static quint64 cellKey(int rowId, int colId) { return (quint64(quint32(rowId)) << 32) | quint32(colId); }
+  void dropOverlay(int rowId, int colId); // -1 = any
+  QString textOf(int rowId, int colId) const { return textIn(store_.get(), overlay_, rowId, colId); }
+  // Cell reads by id, shared by the model and its snapshots
+  static QString textIn(const CsvBackingStore* store, const QHash<quint64, QString>& overlay, int rowId, int colId);
+  static bool numberIn(const CsvBackingStore* store, const QHash<quint64, QString>& overlay, int rowId, int colId,
+                       double& out);
+  static int codeIn(const CsvBackingStore* store, const QHash<quint64, QString>& overlay, int rowId, int colId);
+  void dropSearchIndex();
+  void removeRowRuns(const QVector<QPair<int, int>>& runs); // ascending, disjoint, not adjacent
 
   // explicit numeric columns (lowercase header keys)
   QSet<QString> numericColsLower_;
+  QVector<ColumnType> colTypes_; // per view column, resolved whenever headers or schema change
 
-  bool isNumericColumn(int col) const;
-  static bool parseNumber(QString s, double& out);
+  ColumnType resolveColumnType(const QString& header) const;
+  void resolveColumnTypes();
+  bool isNumericColumn(int col) const { return columnType(col) == ColumnType::Numeric; }
 };
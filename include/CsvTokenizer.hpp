@@ -0,0 +1,46 @@
+#pragma once
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Single-pass CSV tokenizer over raw UTF-8 bytes.
+// Same field semantics as CsvUtils::readCsvRecord + parseCsvRecord, but quotes,
+// commas and newlines are located 64 bytes at a time (AVX2 / SSE2 / scalar).
+namespace CsvTokenizer {
+
+  // One field as a byte range in the source buffer (surrounding quotes included)
+  struct Field {
+    qint64 begin = 0;
+    qint32 size = 0;
+    bool plain = true;   // no quotes / CR inside: decodes straight from the bytes
+  };
+
+  // Field boundaries of a whole document.
+  // Record r owns fields [recordStart[r], recordStart[r + 1]).
+  // Blank (whitespace-only) records are skipped, as the line-by-line loader always did.
+  struct Index {
+    QVector<Field> fields;
+    QVector<qsizetype> recordStart{0};
+
+    qsizetype recordCount() const { return recordStart.size() - 1; }
+    qsizetype fieldCount(qsizetype record) const { return recordStart[record + 1] - recordStart[record]; }
+  };
+
+  // Byte range of one whole record (line break excluded)
+  struct Record {
+    qint64 begin = 0;
+    qint64 end = 0;
+  };
+
+  Index tokenize(const char* data, qint64 size);
+
+  // Record boundaries only (no per-field index), for lazily decoded stores
+  QVector<Record> indexRecords(const char* data, qint64 size);
+  bool findField(const char* data, const Record& rec, int col, Field& out); // false if the record is shorter
+  QStringList splitRecord(const char* data, const Record& rec);
+
+  QString decodeField(const char* data, const Field& f);
+  void appendFieldUtf8(QByteArray& out, const char* data, const Field& f); // unescaped bytes
+  QStringList decodeRecord(const char* data, const Index& idx, qsizetype record);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "CsvBackingStore.hpp"
+
+#include <QByteArray>
+#include <QStringEncoder>
+
+class QIODevice;
+
+// Streaming CSV encoder: fields are quoted after one scan and encoded straight into a
+// reusable UTF-8 block that is flushed to the device in large writes.
+class CsvWriter : public CsvCellSink {
+public:
+  explicit CsvWriter(QIODevice* device, qsizetype blockSize = 1 << 20);
+
+  void text(QStringView field) override;
+  void utf8(QByteArrayView field) override;
+  void endRecord() override;
+
+  bool flush(); // false once any write failed
+
+private:
+  char* reserve(qsizetype bytes); // room for `bytes` more at the returned write position
+  void separator();
+
+  QIODevice* device_ = nullptr;
+  QByteArray buffer_;
+  qsizetype used_ = 0;
+  bool firstField_ = true;
+  bool ok_ = true;
+  QStringEncoder encoder_{QStringConverter::Utf8, QStringConverter::Flag::Stateless};
+};
@@ -2,25 +2,38 @@
 
 #include <QWidget>
 #include <QString>
+#include <QAbstractItemView>
+#include <QHash>
 
+#include <map>
+#include <memory>
+
+class QCheckBox;
 class QComboBox;
 class QTableView;
 class QPushButton;
 class QLineEdit;
-class QSortFilterProxyModel;
+class QProgressBar;
+class QThreadPool;
+class QTimer;
+class QFutureWatcherBase;
 
 class CsvTableModel;
+class RowFilterProxy;
 
 class DbEditorWidget : public QWidget {
   Q_OBJECT
 public:
   explicit DbEditorWidget(QWidget* parent = nullptr);
+  ~DbEditorWidget() override;
 
 private slots:
   void onDatabaseChanged(int idx);
   void onLoad();
   void onSave();
   void onSaveAll();
+  void onBackups();
+  void onExportCsv();
 
   void onAddRow();
   void onDeleteRow();
@@ -29,20 +42,40 @@ private slots:
   void onDeleteColumn();
 
 private:
-  void loadDb(const QString& path);
-  void saveDb(const QString& path);
-  void setDirty(bool on);
+  // One database kept in memory with its own edits, filter and view position
+  struct OpenDb;
+
+  OpenDb& openDb(const QString& path);   // resident one, or a new one that starts loading
+  OpenDb* findDb(const QString& path) const;
+  void showDb(OpenDb& db);               // swap the view over to it; nothing is reloaded
+  void evictIdle();                      // drop clean tables past the memory budget, oldest first
+
+  void startLoad(OpenDb& db);            // background, rows appear as they are parsed
+  void startSave(OpenDb& db);            // snapshot now, write on a worker; editing goes on
+  void startHeadlessSave(const QString& path); // database not in memory: fold its journal in on a worker
+  bool commitEdits(OpenDb& db);          // Save: journal pending edits, compacting the journal when due
+  bool commitJournal(OpenDb& db);        // append pending edits to the journal, nothing else
+  void replayJournal(OpenDb& db);
+  void startValidation(OpenDb& db);      // check the loaded table against its schema rules on a worker
+  QThreadPool* saveThreadFor(const QString& path);
+  void waitForSaves(const QString& path);
+  void setDirty(OpenDb& db, bool on);
+  void setLoading(bool on);
 
   QComboBox* dbSelector_ = nullptr;
   QLineEdit* search_ = nullptr;
+  QCheckBox* fuzzy_ = nullptr;
+  QTimer* searchDebounce_ = nullptr;
 
   QTableView* table_ = nullptr;
-  CsvTableModel* model_ = nullptr;
-  QSortFilterProxyModel* proxy_ = nullptr;
+  CsvTableModel* model_ = nullptr;  // the shown database's
+  RowFilterProxy* proxy_ = nullptr;
 
   QPushButton* loadBtn_ = nullptr;
   QPushButton* saveBtn_ = nullptr;
   QPushButton* saveAllBtn_ = nullptr;
+  QPushButton* backupsBtn_ = nullptr;
+  QPushButton* exportBtn_ = nullptr;
 
   QPushButton* addRowBtn_ = nullptr;
   QPushButton* delRowBtn_ = nullptr;
@@ -50,9 +83,19 @@ private:
   QPushButton* addColBtn_ = nullptr;
   QPushButton* delColBtn_ = nullptr;
 
+  QProgressBar* loadProgress_ = nullptr;
+  QAbstractItemView::EditTriggers editTriggers_;
+
+  QHash<QString, QThreadPool*> saveThreads_; // path -> one thread: a file's saves land in order, files in parallel
+  QHash<QString, int> pendingSaves_;   // path -> saves not finished yet
+  QHash<QString, QFutureWatcherBase*> headlessSaves_; // Save All of databases not in memory
+
+  std::map<QString, std::unique_ptr<OpenDb>> dbs_; // path -> resident database
+  OpenDb* current_ = nullptr;
+  quint64 useClock_ = 0;                 // ticks on every switch, for least-recently-used eviction
+  bool journalMuted_ = false;            // replaying: model changes are not new edits
+
   QString currentPath_;
-  bool dirty_ = false;
 
   int lastHeaderCol_ = -1;
-  int lastIndex_ = 0;
 };
@@ -0,0 +1,58 @@
+#pragma once
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+class CsvTableModel;
+
+// Append-only write-ahead log of edits next to each CSV (e.g. "data/material.csv.journal").
+// Saving appends the edits made since the last save with one fsync; the CSV itself is only
+// rewritten when the journal is compacted. A journal is tied to the exact CSV it extends
+// (size + mtime), so it is ignored once the CSV changes underneath it. A compaction names the
+// new CSV in the journal before putting it in place, so a crash on either side of that replays
+// exactly the records the CSV on disk lacks. Any thread.
+class EditJournal {
+public:
+  enum class Op : quint8 {
+    SetCell = 1,   // row, col, text
+    InsertRows,    // row = first, count
+    RemoveRows,    // row = first, count
+    AddColumn,     // col, text = name, numeric
+    RemoveColumn,  // col
+  };
+
+  // Positions are view rows/columns at the time of the edit, so records replay in order
+  struct Record {
+    Op op = Op::SetCell;
+    int row = 0;
+    int col = 0;
+    int count = 0;
+    bool numeric = false;
+    QString text;
+  };
+
+  explicit EditJournal(QString csvPath);
+
+  const QString& csvPath() const { return csvPath_; }
+
+  void record(const Record& r); // pending until commit()
+  bool hasPending() const { return !pending_.isEmpty(); }
+  void discardPending() { pending_.clear(); }
+  bool commit(QString* error = nullptr);
+
+  static QString journalPathFor(const QString& csvPath);
+  static qint64 committedSize(const QString& csvPath);          // bytes on disk, 0 when none
+  static QVector<Record> readCommitted(const QString& csvPath); // empty when missing or stale
+  // Compaction: the CSV about to replace the current one (its size and mtime in ms) holds the
+  // bytes before keepFrom; call before the replace, then rebase() once it is in place
+  static bool prepareRebase(const QString& csvPath, qint64 keepFrom, qint64 nextSize, qint64 nextMtime);
+  static bool rebase(const QString& csvPath, qint64 keepFrom);  // after compaction: bytes before keepFrom are in the CSV
+  static void discard(const QString& csvPath);
+
+  // Replays records onto the table they were written against; stops at the first one that does not fit
+  static void apply(CsvTableModel& model, const QVector<Record>& records);
+
+private:
+  QString csvPath_;
+  QByteArray pending_; // encoded records
+};
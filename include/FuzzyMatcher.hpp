@@ -0,0 +1,36 @@
+#pragma once
+#include <QHash>
+#include <QString>
+
+#include <algorithm>
+#include <array>
+
+// Approximate substring search with Myers' bit-vector algorithm: one pass over the text,
+// the whole pattern advanced by a handful of 64-bit operations per character.
+// Case-insensitive; patterns of up to 64 characters.
+class FuzzyMatcher {
+public:
+  static constexpr int kMaxPattern = 64;
+
+  explicit FuzzyMatcher(QStringView pattern); // longer patterns: isValid() is false
+
+  bool isValid() const { return length_ > 0; }
+  int length() const { return length_; }
+
+  // Fewest edits (insertions, deletions, substitutions) turning the pattern into some
+  // substring of `text`; stops early and returns `limit + 1` once nothing can get under it
+  int distance(QStringView text, int limit) const;
+
+  // Errors still worth showing for a pattern of `length` characters: none for short codes
+  static int defaultLimit(int length) { return length < 4 ? 0 : std::max(1, length / 4); }
+
+private:
+  quint64 peq(char16_t c) const {
+    if (c < ascii_.size()) return ascii_[c];
+    return other_.value(c, 0);
+  }
+
+  std::array<quint64, 128> ascii_{}; // character -> pattern positions holding it
+  QHash<char16_t, quint64> other_;
+  int length_ = 0;
+};
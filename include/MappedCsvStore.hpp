@@ -0,0 +1,30 @@
+#pragma once
+#include "CsvBackingStore.hpp"
+#include "CsvTokenizer.hpp"
+
+#include <QFile>
+#include <memory>
+
+// Memory-mapped CSV file with a record offset index.
+// Cells are decoded from UTF-8 only when asked for (visible cells, saves).
+class MappedCsvStore : public CsvBackingStore {
+public:
+  static std::shared_ptr<MappedCsvStore> open(const QString& path, QString* error = nullptr);
+
+  QStringList headers() const override { return headers_; }
+  int rowCount() const override { return int(records_.size()) - 1; }
+  int columnCount() const override { return headers_.size(); }
+  QString cell(int row, int col) const override;
+  void writeCell(int row, int col, CsvCellSink& sink) const override;
+  bool viewUtf8(int row, int col, QByteArrayView& out) const override; // unquoted fields
+
+  qint64 memoryBytes() const override { return file_.size() + records_.size() * qint64(sizeof(CsvTokenizer::Record)); }
+
+private:
+  MappedCsvStore() = default;
+
+  QFile file_;
+  const char* data_ = nullptr;
+  QStringList headers_;
+  QVector<CsvTokenizer::Record> records_; // [0] = header record
+};
@@ -0,0 +1,18 @@
+#pragma once
+#include <QByteArrayView>
+#include <QStringView>
+
+// Numbers as the table accepts them: optional sign, digits with at most one decimal point or
+// decimal comma ("-12", "12,5", "12.", ".5"), surrounding whitespace ignored; no exponents.
+// A hand-written scan checks the grammar, std::from_chars converts; nothing is allocated.
+namespace NumberParser {
+
+  bool parse(QStringView text, double& out);  // UTF-16, e.g. edited cells
+  bool parse(QByteArrayView utf8, double& out); // UTF-8 straight from a store
+
+  // A whole column of UTF-8 cells [offsets[r], offsets[r + 1]) in one arena.
+  // Every number lands in values[r] with bit r of `valid` set ((rows + 63) / 64 words, cleared
+  // by the caller); empty cells are left clear. Stops at the first cell that is neither and
+  // returns its row, or -1 when the whole column parsed.
+  int parseColumn(const char* arena, const quint32* offsets, int rows, double* values, quint64* valid);
+}
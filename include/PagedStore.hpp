@@ -0,0 +1,123 @@
+#pragma once
+#include "CsvTableModel.hpp"
+
+#include <QByteArray>
+#include <QCache>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <functional>
+#include <memory>
+
+class CsvBackingStore;
+
+// Every table in one file of fixed-size pages (e.g. "data/admin.pdb"):
+//   page 0       header: page count, catalog, free page list
+//   chains       linked pages holding one blob: the catalog (table name -> meta), each table's
+//                meta (headers, counters) and its row directory (row order -> record location)
+//   data pages   slotted pages of row records, appended to; rows bigger than half a page get a chain
+// A save is one transaction: the pages it changed go to the write-ahead log ("admin.pdb-wal")
+// with a commit mark and one fsync, then into the file. A crash in between is redone on the next
+// open; a torn log is dropped. Saving edits writes the records of changed rows and the directory
+// and meta pages whose bytes changed, not the table. Records left behind by edits are reclaimed
+// by rewriting the table once they outweigh the live ones.
+// Any thread; calls are serialized.
+class PagedStore {
+public:
+  explicit PagedStore(QString path);
+  ~PagedStore();
+
+  const QString& path() const { return path_; }
+
+  bool hasTable(const QString& name);
+
+  // Whole table decoded into memory; remembers where each row lives so save() can skip
+  // rows that did not change. nullptr (and `error`) when missing or unreadable.
+  std::shared_ptr<const CsvBackingStore> load(const QString& name, QString* error = nullptr);
+
+  // The snapshot becomes the table. Only rows whose content differs from what the file holds
+  // for them are written: rows of `snap.store` as loaded from this file or as the last save from
+  // it left them. Anything else (other source, columns changed) rewrites the table.
+  bool save(const QString& name, const CsvTableModel::Snapshot& snap, QString* error = nullptr);
+
+  // Replaces the table with the content of any store (CSV import)
+  bool import(const QString& name, const CsvBackingStore& store, QString* error = nullptr);
+
+  static constexpr int kPageSize = 8192;
+
+private:
+  using CellText = std::function<QString(int row, int col)>;
+
+  struct Header {
+    quint32 pageCount = 1;
+    quint32 catalog = 0; // chain head, 0 = no tables yet
+    quint32 freeList = 0;
+  };
+
+  // Table meta blob
+  struct Meta {
+    QStringList headers;
+    quint32 rows = 0;
+    quint32 directory = 0; // chain of u64 locators, one per row in order
+    quint32 dataPages = 0; // chain of u32 page numbers of this table's data pages
+    quint32 tail = 0;      // data page new records go to
+    quint64 generation = 0; // bumped by full rewrites: older locators are void
+    quint64 liveBytes = 0;
+    quint64 deadBytes = 0;
+  };
+
+  bool open(QString* error);
+  bool recover(QString* error);
+
+  // Pages: reads see this transaction's writes; put() only stages bytes that differ
+  QByteArray page(quint32 no);
+  void put(quint32 no, const QByteArray& bytes);
+  quint32 allocate();
+  void release(quint32 no);
+  bool commit(QString* error);
+  void rollback();
+
+  QVector<quint32> chainPages(quint32 head);
+  QByteArray readChain(quint32 head);
+  quint32 writeChain(quint32 head, const QByteArray& bytes); // reuses the chain's pages in order
+  void releaseChain(quint32 head);
+
+  QMap<QString, quint32> readCatalog(); // table name -> meta chain
+  void writeCatalog(const QMap<QString, quint32>& catalog);
+  Meta readMeta(quint32 head);
+  quint32 writeMeta(quint32 head, const Meta& meta);
+
+  quint64 storeRecord(Meta& meta, QVector<quint32>& dataPages, const QByteArray& record);
+  QByteArray readRecord(quint64 locator);
+  void dropRecord(Meta& meta, quint64 locator);
+  bool writeTable(const QString& name, const QStringList& headers, int rows, const CellText& cell, QString* error,
+                  QVector<quint64>* locators = nullptr);
+  bool rewrite(const QString& name, const CsvTableModel::Snapshot& snap, QString* error);
+
+  // Where the last save of a table put each row, by row id of the snapshot store it started from.
+  // Lets the next save from that store keep those records instead of writing its edits again.
+  struct Written {
+    std::weak_ptr<const CsvBackingStore> base;
+    quint64 generation = 0;
+    QVector<int> colIds;
+    QVector<quint64> locators;      // by row id, 0 = none
+    QHash<int, QByteArray> records; // rows not read from `base` (edited, added): the record written
+  };
+
+  QString path_;
+  QFile file_;
+  QFile wal_;
+  bool opened_ = false;
+  QMutex mutex_;
+
+  Header header_;
+  Header committedHeader_;
+  QHash<quint32, QByteArray> dirty_;  // this transaction's pages
+  QCache<quint32, QByteArray> cache_; // committed pages, least recently used dropped first
+  QHash<QString, Written> written_;    // by table name
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <QPair>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+#include <utility>
+
+// Stable merge sort on the global thread pool: slices are sorted in parallel, then merged
+// pairwise, each round of merges in parallel too. Small inputs just use std::stable_sort.
+namespace ParallelSort {
+
+  constexpr qsizetype kMinParallelItems = 1 << 15;
+
+  template <typename T, typename Less>
+  void stableSort(QVector<T>& v, Less less) {
+    const qsizetype n = v.size();
+    const int threads = QThread::idealThreadCount();
+    if (n < kMinParallelItems || threads < 2) {
+      std::stable_sort(v.begin(), v.end(), less);
+      return;
+    }
+
+    T* data = v.data(); // detach once, before any worker touches it
+
+    // [begin, end) slices, then runs of width, 2 * width, ... are merged
+    const qsizetype width = (n + threads - 1) / threads;
+    QVector<QPair<qsizetype, qsizetype>> slices;
+    for (qsizetype from = 0; from < n; from += width) slices.push_back({from, std::min(n, from + width)});
+    QtConcurrent::blockingMap(slices, [data, &less](const QPair<qsizetype, qsizetype>& s) {
+      std::stable_sort(data + s.first, data + s.second, less);
+    });
+
+    QVector<T> buffer(n);
+    T* src = data;
+    T* dst = buffer.data();
+    for (qsizetype run = width; run < n; run *= 2) {
+      QVector<qsizetype> starts;
+      for (qsizetype lo = 0; lo < n; lo += 2 * run) starts.push_back(lo);
+      QtConcurrent::blockingMap(starts, [=, &less](qsizetype lo) {
+        const qsizetype mid = std::min(n, lo + run);
+        const qsizetype hi = std::min(n, lo + 2 * run);
+        std::merge(src + lo, src + mid, src + mid, src + hi, dst + lo, less); // stable: left run first
+      });
+      std::swap(src, dst);
+    }
+    if (src != data) std::copy(src, src + n, data);
+  }
+
+} // namespace ParallelSort
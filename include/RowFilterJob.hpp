@@ -0,0 +1,35 @@
+#pragma once
+#include "CsvTableModel.hpp"
+#include "RowQuery.hpp"
+
+#include <QBitArray>
+#include <QPointer>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// Runs one search over a model snapshot on the thread pool, rows split into shards, and hands
+// back the accepted rows; the GUI thread only ever sees finished results.
+class RowFilterJob : public std::enable_shared_from_this<RowFilterJob> {
+public:
+  // Bit per snapshot row; typo counts per row for fuzzy queries, else empty
+  using Callback = std::function<void(const QBitArray& accepted, const QVector<quint8>& scores)>;
+
+  // onDone runs on the GUI thread, and only while `context` is alive and the job is not cancelled.
+  // Rows clear in `mask` (empty = all rows) are rejected without being looked at.
+  static std::shared_ptr<RowFilterJob> start(CsvTableModel::Snapshot snap, RowQuery query, QBitArray mask,
+                                             QObject* context, Callback onDone);
+
+  void cancel() { cancelled_ = true; } // remaining shards are skipped
+  bool isCancelled() const { return cancelled_; }
+
+private:
+  RowFilterJob(QObject* context, Callback onDone);
+
+  void run(const CsvTableModel::Snapshot& snap, const RowQuery& query, const QBitArray& mask);
+
+  QPointer<QObject> context_; // only read on the GUI thread
+  Callback onDone_;
+  std::atomic_bool cancelled_{false};
+};
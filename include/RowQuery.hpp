@@ -0,0 +1,64 @@
+#pragma once
+#include "CsvTableModel.hpp"
+
+#include <QBitArray>
+#include <QString>
+#include <QVector>
+
+#include <memory>
+
+class FuzzyMatcher;
+
+// Search box query: whitespace-separated terms that must all match.
+//   MinTon>=80 MaxTon<200   numeric range on a numeric column (also >, <=, =, !=)
+//   NAME:st37               that column contains the text
+//   NAME=ST37               that column is exactly the text (case-insensitive)
+//   st37                    any column contains the text
+// Column names compare like schema keys (trimmed, case-insensitive); "double quotes" keep spaces.
+// Text without any column term is one plain substring, exactly as before; quotes around all of it
+// only group it, any other quote is searched for.
+// Fuzzy mode lets text terms match with a few typos (FuzzyMatcher); rows are then scored by errors.
+class RowQuery {
+public:
+  // Columns are resolved against the model as it is now; re-parse when its headers change
+  static RowQuery parse(const QString& text, const CsvTableModel& model, bool fuzzy = false);
+
+  bool isPlainText() const { return plain_; }
+  bool isFuzzy() const { return fuzzy_; } // some term tolerates typos: rows have scores
+  bool isEmpty() const { return terms_.isEmpty(); } // matches every row
+  QString plainText() const; // the substring a plain-text query looks for
+
+  // View rows of `model` that may match, from its trigram index (CsvTableModel::searchCandidates).
+  // False when the index cannot answer for this query: every row must be checked.
+  bool candidates(const CsvTableModel& model, QVector<int>& rows) const;
+
+  // Which of rows [from, to) pass every term; bit i is row from + i. Only rows set in `mask`
+  // (empty = all) are looked at. Terms run one column at a time, cheapest first, each over the
+  // rows the earlier ones kept; evaluation stops as soon as no row is left.
+  // Reads only the snapshot, so shards of one table can be evaluated on several threads.
+  // `scores` (optional) receives each row's typo count summed over the terms, 0 = exact.
+  QBitArray evaluate(const CsvTableModel::Snapshot& snap, int from, int to, const QBitArray& mask = {},
+                     QVector<quint8>* scores = nullptr) const;
+
+private:
+  enum class Op : quint8 { Contains, Equals, NotEquals, Less, LessEq, Greater, GreaterEq };
+
+  struct Term {
+    int col = -1;         // -1: any column
+    Op op = Op::Contains;
+    bool numeric = false; // compare parsed values, not text
+    double number = 0.0;
+    QString text;
+    std::shared_ptr<const FuzzyMatcher> fuzzy; // Contains with typos allowed
+    int maxErrors = 0;
+  };
+
+  static int score(const Term& t, const QString& cell); // -1 = no match, else errors
+  static bool matches(const Term& t, const QString& cell);
+  static bool matchesNumber(const Term& t, double v);
+  static int cost(const Term& t);
+
+  QVector<Term> terms_;
+  bool plain_ = true;
+  bool fuzzy_ = false;
+};
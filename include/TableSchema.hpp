@@ -0,0 +1,61 @@
+#pragma once
+#include "CsvTableModel.hpp"
+
+#include <QHash>
+#include <QJsonObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Column rules from the sidecar next to each CSV (e.g. "data/material.csv.schema.json"):
+//   { "numeric": ["minton", "maxton"],
+//     "columns": { "MinTon":   { "type": "int", "min": 0, "max": 5000, "required": true },
+//                  "Material": { "type": "enum", "values": ["ST37", "S355"] },
+//                  "Code":     { "type": "text", "required": true, "unique": true } } }
+// "numeric" is kept up to date by the editor; "columns" is written by hand and kept as is.
+// Types: text, int, float, enum; int and float columns are numeric columns as well.
+class TableSchema {
+public:
+  enum class Type : quint8 { Text, Int, Float, Enum };
+
+  struct Rule {
+    Type type = Type::Text;
+    bool required = false; // empty cells are errors (otherwise they pass every check)
+    bool unique = false;   // trimmed text may not repeat
+    bool hasMin = false;
+    bool hasMax = false;
+    double min = 0.0;
+    double max = 0.0;
+    QStringList values;    // enum: allowed values, case-insensitive
+  };
+
+  // One broken rule; row and column are view positions in the validated snapshot, rowId is the
+  // row's stable id there (CsvTableModel::rowOfId finds it after rows were added or removed)
+  struct Issue {
+    int row = 0;
+    int col = 0;
+    QString reason;
+    int rowId = 0;
+  };
+
+  static QString pathFor(const QString& csvPath);
+  static TableSchema load(const QString& csvPath); // empty when missing or unreadable
+  bool save(const QString& csvPath) const;
+
+  QSet<QString> numericColumns() const; // lowercase header keys: "numeric" plus int/float rules
+  void setNumericColumns(const QSet<QString>& colsLower); // becomes "numeric", minus what rules imply
+
+  bool hasRules() const { return !rules_.isEmpty(); }
+
+  // Every broken rule, ordered by row then column. The rules are compiled once against the
+  // snapshot's headers, then each column is checked on its own thread in one pass.
+  // At most kMaxIssuesPerColumn are reported per column.
+  QVector<Issue> validate(const CsvTableModel::Snapshot& snap) const;
+  static constexpr int kMaxIssuesPerColumn = 1000;
+
+private:
+  QJsonObject doc_;              // whole sidecar, so keys the editor does not know survive a save
+  QSet<QString> numeric_;
+  QHash<QString, Rule> rules_;   // lowercase header key -> rule
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include "CsvLoadJob.hpp"
+#include "CsvTableModel.hpp"
+
+#include <QString>
+#include <memory>
+
+class CsvBackingStore;
+class QObject;
+
+// Where the editor's tables live. Tables are named by their CSV path (AdminDbPaths) either way.
+//   CSV files (default)  each table is its CSV; a save rewrites the file, so edits go to an
+//                        EditJournal in between and every save keeps a backup
+//   paged file           every table in one PagedStore (build with PBADMIN_PAGED_STORAGE); a table
+//                        missing from it is imported from its CSV and that CSV's journal, a save
+//                        writes the rows that changed
+class TableStorage {
+public:
+  virtual ~TableStorage() = default;
+
+  static TableStorage& instance(); // the backend this build uses
+
+  // Background load; see CsvLoadJob::start
+  virtual std::shared_ptr<CsvLoadJob> startLoad(const QString& csvPath, QObject* context, CsvLoadJob::Callback onUpdate) = 0;
+  // Blocking, any thread. nullptr without an error: there is no such table yet
+  virtual std::shared_ptr<const CsvBackingStore> load(const QString& csvPath, QString* error = nullptr) = 0;
+  // Any thread; saves of one table must not overlap. `journalMark`: the snapshot holds the
+  // table's EditJournal up to that size, which is cut from the journal with the save (-1: leave it)
+  virtual bool save(const QString& csvPath, const CsvTableModel::Snapshot& snap, QString* error = nullptr,
+                    qint64 journalMark = -1) = 0;
+
+  // The CSV files are the tables: journals, backups and binary caches apply
+  virtual bool usesCsvFiles() const = 0;
+};
@@ -0,0 +1,31 @@
+#pragma once
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include <memory>
+
+class CsvBackingStore;
+
+// Inverted index from trigrams of case-folded cell text to the row ids containing them.
+// Only ever grows: edits add the new text's trigrams, removed rows and overwritten text leave
+// stale entries behind, so candidates() may over-report and callers verify every hit.
+class TrigramIndex {
+public:
+  static constexpr int kGram = 3;
+
+  // Whole store, rows sliced across the thread pool; row id = store row
+  static std::shared_ptr<TrigramIndex> build(const CsvBackingStore& store);
+
+  void add(int rowId, QStringView text);
+
+  // Row ids that may contain `needle` (case-insensitive), ascending. Needle must have kGram+ chars.
+  QVector<int> candidates(QStringView needle) const;
+
+  qint64 memoryBytes() const; // postings, approximately
+
+private:
+  static void appendTrigrams(QStringView folded, QVector<quint64>& out);
+
+  QHash<quint64, QVector<int>> postings_; // trigram -> ascending row ids
+};
@@ -21,4 +21,8 @@ QString pathForKey(const QString& key) {
   return {};
 }
 
+QString pagedStorePath() {
+  return "data/admin.pdb";
+}
+
 } // namespace AdminDbPaths
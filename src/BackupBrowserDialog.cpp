@@ -0,0 +1,98 @@
+#include "BackupBrowserDialog.hpp"
+#include "BackupStore.hpp"
+#include "CsvTableModel.hpp"
+#include "MappedCsvStore.hpp"
+
+#include <QDialogButtonBox>
+#include <QFileInfo>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLocale>
+#include <QPushButton>
+#include <QSplitter>
+#include <QTableView>
+#include <QTableWidget>
+#include <QVBoxLayout>
+
+BackupBrowserDialog::BackupBrowserDialog(const QString& csvPath, QWidget* parent)
+  : QDialog(parent), csvPath_(csvPath) {
+  setWindowTitle("Backups of " + QFileInfo(csvPath).fileName());
+  setModal(true);
+  resize(960, 600);
+
+  auto* v = new QVBoxLayout(this);
+  auto* split = new QSplitter(Qt::Horizontal, this);
+
+  list_ = new QTableWidget(0, 3, this);
+  list_->setHorizontalHeaderLabels({"Saved", "Rows", "Size"});
+  list_->setSelectionBehavior(QAbstractItemView::SelectRows);
+  list_->setSelectionMode(QAbstractItemView::SingleSelection);
+  list_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  list_->verticalHeader()->setVisible(false);
+  list_->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+  split->addWidget(list_);
+
+  model_ = new CsvTableModel(this);
+  preview_ = new QTableView(this);
+  preview_->setModel(model_);
+  preview_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  preview_->setAlternatingRowColors(true);
+  split->addWidget(preview_);
+  split->setStretchFactor(1, 1);
+  v->addWidget(split, 1);
+
+  status_ = new QLabel(this);
+  v->addWidget(status_);
+
+  auto* buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+  restoreBtn_ = new QPushButton("Restore", this);
+  restoreBtn_->setEnabled(false);
+  buttons->addButton(restoreBtn_, QDialogButtonBox::AcceptRole);
+  v->addWidget(buttons);
+
+  connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+  connect(restoreBtn_, &QPushButton::clicked, this, &QDialog::accept);
+
+  // Straight from the backup index: no directory is listed, no manifest opened
+  const QLocale locale;
+  const QVector<BackupStore::Entry> entries = BackupStore::list(csvPath);
+  list_->setRowCount(entries.size());
+  for (int i = 0; i < entries.size(); ++i) {
+    const auto& e = entries[i];
+    auto* when = new QTableWidgetItem(locale.toString(e.created, QLocale::ShortFormat));
+    when->setData(Qt::UserRole, e.manifestPath);
+    when->setToolTip("SHA-256 " + e.sha256);
+    list_->setItem(i, 0, when);
+    list_->setItem(i, 1, new QTableWidgetItem(e.rows >= 0 ? locale.toString(e.rows) : QString()));
+    list_->setItem(i, 2, new QTableWidgetItem(locale.formattedDataSize(e.size)));
+  }
+  status_->setText(entries.isEmpty() ? "No backups yet: one is made on every save."
+                                     : QString("%1 backups").arg(entries.size()));
+
+  connect(list_, &QTableWidget::currentCellChanged, this, [this](int row) { preview(row); });
+}
+
+void BackupBrowserDialog::preview(int row) {
+  model_->clear();
+  selected_.clear();
+  restoreBtn_->setEnabled(false);
+
+  const QTableWidgetItem* item = row >= 0 ? list_->item(row, 0) : nullptr;
+  if (!item || !previewDir_.isValid()) return;
+
+  // One sequential rebuild; the table then decodes only what the view asks for
+  const QString manifest = item->data(Qt::UserRole).toString();
+  const QString path = previewDir_.filePath(QFileInfo(csvPath_).fileName());
+  QString error;
+  std::shared_ptr<MappedCsvStore> store;
+  if (BackupStore::restore(manifest, path, &error)) store = MappedCsvStore::open(path, &error);
+  if (!store) {
+    status_->setText("Cannot open this backup: " + error);
+    return;
+  }
+
+  model_->setStore(std::move(store));
+  selected_ = manifest;
+  restoreBtn_->setEnabled(true);
+  status_->setText("Preview of the backup from " + item->text() + " (read-only)");
+}
@@ -0,0 +1,496 @@
+#include "BackupStore.hpp"
+#include "CsvTokenizer.hpp"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QSaveFile>
+#include <QSet>
+
+#include <algorithm>
+#include <array>
+
+namespace {
+
+// Chunk sizes: boundaries where the rolling hash has its low 13 bits clear (~8 KiB apart),
+// never closer than kMinChunk or further than kMaxChunk
+constexpr qint64 kMinChunk = 2 * 1024;
+constexpr qint64 kMaxChunk = 64 * 1024;
+constexpr quint64 kBoundaryMask = (quint64(1) << 13) - 1;
+
+// Every this many backups the manifest lists all chunks again instead of a delta,
+// so restoring never applies more than this many deltas
+constexpr int kKeyframeInterval = 16;
+
+// Fixed pseudo-random table for the gear hash; it must never change, or no chunk is shared
+// with older backups any more
+const std::array<quint64, 256>& gearTable() {
+  static const std::array<quint64, 256> table = [] {
+    std::array<quint64, 256> t{};
+    quint64 x = 0x9E3779B97F4A7C15ull;
+    for (auto& v : t) {
+      // splitmix64
+      x += 0x9E3779B97F4A7C15ull;
+      quint64 z = x;
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      v = z ^ (z >> 31);
+    }
+    return t;
+  }();
+  return table;
+}
+
+// Length of the chunk starting at `data`
+qint64 chunkLength(const uchar* data, qint64 size) {
+  if (size <= kMinChunk) return size;
+  const auto& gear = gearTable();
+  const qint64 end = std::min(size, kMaxChunk);
+  quint64 h = 0;
+  for (qint64 i = 0; i < end; ++i) {
+    h = (h << 1) + gear[data[i]];
+    if (i >= kMinChunk && (h & kBoundaryMask) == 0) return i + 1;
+  }
+  return end;
+}
+
+QString hexHash(const char* data, qint64 size) {
+  const QByteArray bytes = QByteArray::fromRawData(data, qsizetype(size));
+  return QString::fromLatin1(QCryptographicHash::hash(bytes, QCryptographicHash::Sha256).toHex());
+}
+
+// Chunks are zlib-compressed; the name is the hash of the uncompressed bytes
+QString chunkPath(const QString& store, const QString& hash) {
+  return store + "/chunks/" + hash.left(2) + "/" + hash + ".z";
+}
+
+QString manifestDir(const QString& store, const QString& fileName) {
+  return store + "/manifests/" + fileName;
+}
+
+QJsonObject readManifest(const QString& manifestPath) {
+  QFile f(manifestPath);
+  if (!f.open(QIODevice::ReadOnly)) return {};
+  return QJsonDocument::fromJson(f.readAll()).object();
+}
+
+bool writeManifest(const QString& manifestPath, const QJsonObject& manifest) {
+  QSaveFile out(manifestPath);
+  if (!out.open(QIODevice::WriteOnly)) return false;
+  out.write(QJsonDocument(manifest).toJson(QJsonDocument::Compact));
+  return out.commit();
+}
+
+// Oldest first; the names are timestamps
+QStringList manifestsOf(const QString& store, const QString& fileName) {
+  const QDir dir(manifestDir(store, fileName));
+  QStringList out;
+  for (const QString& name : dir.entryList({"*.json"}, QDir::Files, QDir::Name)) out << dir.absoluteFilePath(name);
+  return out;
+}
+
+// Per-file index of its backups, oldest first, so saving and listing never scan directories.
+// Missing or unreadable: rebuilt once from the manifests themselves.
+QString indexPath(const QString& store, const QString& fileName) {
+  return store + "/manifests/" + fileName + ".idx";
+}
+
+BackupStore::Entry entryFrom(const QString& manifestPath, const QJsonObject& m) {
+  BackupStore::Entry e;
+  e.manifestPath = manifestPath;
+  e.created = QDateTime::fromString(m.value("created").toString(), Qt::ISODateWithMs);
+  e.size = qint64(m.value("size").toDouble());
+  e.rows = qint64(m.value("rows").toDouble(-1));
+  e.sha256 = m.value("sha256").toString();
+  e.depth = m.value("depth").toInt();
+  return e;
+}
+
+bool writeIndex(const QString& store, const QString& fileName, const QVector<BackupStore::Entry>& entries) {
+  QJsonArray arr;
+  for (const auto& e : entries) {
+    QJsonObject o;
+    o["name"] = QFileInfo(e.manifestPath).fileName();
+    o["created"] = e.created.toString(Qt::ISODateWithMs);
+    o["size"] = double(e.size);
+    o["rows"] = double(e.rows);
+    o["sha256"] = e.sha256;
+    o["depth"] = e.depth;
+    arr.append(o);
+  }
+  QSaveFile out(indexPath(store, fileName));
+  if (!out.open(QIODevice::WriteOnly)) return false;
+  out.write(QJsonDocument(arr).toJson(QJsonDocument::Compact));
+  return out.commit();
+}
+
+QVector<BackupStore::Entry> readIndex(const QString& store, const QString& fileName) {
+  QVector<BackupStore::Entry> entries;
+  QFile f(indexPath(store, fileName));
+  if (f.open(QIODevice::ReadOnly)) {
+    const QJsonDocument doc = QJsonDocument::fromJson(f.readAll());
+    if (doc.isArray()) {
+      const QString dir = manifestDir(store, fileName);
+      for (const auto& v : doc.array()) {
+        const QJsonObject o = v.toObject();
+        entries.push_back(entryFrom(dir + "/" + o.value("name").toString(), o));
+      }
+      return entries;
+    }
+  }
+
+  for (const QString& p : manifestsOf(store, fileName)) entries.push_back(entryFrom(p, readManifest(p)));
+  if (!entries.isEmpty()) writeIndex(store, fileName, entries);
+  return entries;
+}
+
+// Delta manifests describe their chunk list against the previous backup's:
+//   "ops": [[from, count], "hash", ...]   a pair copies that range of the base list, a string adds a chunk
+QJsonArray diffChunks(const QStringList& base, const QStringList& chunks) {
+  QHash<QString, int> where;
+  for (int i = base.size() - 1; i >= 0; --i) where.insert(base[i], i); // first occurrence wins
+
+  QJsonArray ops;
+  int runFrom = -1;
+  int runCount = 0;
+  auto flush = [&] {
+    if (runCount > 0) ops.append(QJsonArray{runFrom, runCount});
+    runCount = 0;
+  };
+  for (const QString& c : chunks) {
+    if (runCount > 0 && runFrom + runCount < base.size() && base[runFrom + runCount] == c) {
+      ++runCount;
+      continue;
+    }
+    flush();
+    const auto it = where.constFind(c);
+    if (it != where.constEnd()) {
+      runFrom = *it;
+      runCount = 1;
+    } else {
+      ops.append(c);
+    }
+  }
+  flush();
+  return ops;
+}
+
+bool applyOps(const QStringList& base, const QJsonArray& ops, QStringList& out) {
+  out.clear();
+  for (const auto& op : ops) {
+    if (op.isString()) {
+      out << op.toString();
+      continue;
+    }
+    const QJsonArray range = op.toArray();
+    const int from = range.at(0).toInt(-1);
+    const int count = range.at(1).toInt(-1);
+    if (from < 0 || count < 0 || from + count > base.size()) return false;
+    out << base.mid(from, count);
+  }
+  return true;
+}
+
+// Chunk list of one manifest: its keyframe plus the deltas after it. `memo` holds lists
+// already resolved (manifest path -> chunks), so walking a whole directory stays linear.
+bool resolveChunks(const QString& manifestPath, QHash<QString, QStringList>& memo, QStringList& out) {
+  if (const auto it = memo.constFind(manifestPath); it != memo.constEnd()) {
+    out = *it;
+    return true;
+  }
+
+  // Back to the nearest keyframe (or resolved manifest)...
+  QVector<QPair<QString, QJsonObject>> chain;
+  QString p = manifestPath;
+  QStringList chunks;
+  while (true) {
+    if (const auto it = memo.constFind(p); it != memo.constEnd()) {
+      chunks = *it;
+      break;
+    }
+    const QJsonObject m = readManifest(p);
+    if (m.isEmpty() || chain.size() > kKeyframeInterval * 4) return false;
+    if (m.contains("chunks")) {
+      for (const auto& c : m.value("chunks").toArray()) chunks << c.toString();
+      memo.insert(p, chunks);
+      break;
+    }
+    chain.push_back({p, m});
+    p = QFileInfo(p).absolutePath() + "/" + m.value("base").toString();
+  }
+
+  // ...then forward through the deltas
+  for (qsizetype i = chain.size() - 1; i >= 0; --i) {
+    QStringList next;
+    if (!applyOps(chunks, chain[i].second.value("ops").toArray(), next)) return false;
+    chunks = std::move(next);
+    memo.insert(chain[i].first, chunks);
+  }
+  out = chunks;
+  return true;
+}
+
+// Store-wide count of the backups (of any file) referring to each chunk, so expiring a backup
+// only looks at its own chunks: chunk hash -> count
+QString refsPath(const QString& store) {
+  return store + "/chunks.refs";
+}
+
+// Every manifest counted once: stores from before the counts, or a lost counts file
+bool countRefs(const QString& store, QHash<QString, int>& refs) {
+  refs.clear();
+  QHash<QString, QStringList> memo;
+  QDirIterator manifests(store + "/manifests", {"*.json"}, QDir::Files, QDirIterator::Subdirectories);
+  while (manifests.hasNext()) {
+    QStringList chunks;
+    if (!resolveChunks(manifests.next(), memo, chunks)) return false; // unreadable: counts unknown
+    for (const QString& c : QSet<QString>(chunks.cbegin(), chunks.cend())) ++refs[c];
+  }
+  return true;
+}
+
+bool readRefs(const QString& store, QHash<QString, int>& refs) {
+  QFile f(refsPath(store));
+  if (f.open(QIODevice::ReadOnly)) {
+    const QJsonDocument doc = QJsonDocument::fromJson(f.readAll());
+    if (doc.isObject()) {
+      const QJsonObject o = doc.object();
+      refs.clear();
+      refs.reserve(o.size());
+      for (auto it = o.constBegin(); it != o.constEnd(); ++it) refs.insert(it.key(), it.value().toInt());
+      return true;
+    }
+  }
+  return countRefs(store, refs);
+}
+
+bool writeRefs(const QString& store, const QHash<QString, int>& refs) {
+  QJsonObject o;
+  for (auto it = refs.constBegin(); it != refs.constEnd(); ++it) o.insert(it.key(), it.value());
+  QSaveFile out(refsPath(store));
+  if (!out.open(QIODevice::WriteOnly)) return false;
+  out.write(QJsonDocument(o).toJson(QJsonDocument::Compact));
+  return out.commit();
+}
+
+QMutex& storeMutex() {
+  static QMutex m;
+  return m;
+}
+
+} // namespace
+
+namespace BackupStore {
+
+QString storeDirFor(const QString& path) {
+  return QFileInfo(path).absolutePath() + "/.backups";
+}
+
+bool backup(const QString& path, int keepN, QString* error) {
+  const QFileInfo fi(path);
+  if (!fi.exists() || !fi.isFile()) return true;
+
+  QFile src(path);
+  if (!src.open(QIODevice::ReadOnly)) {
+    if (error) *error = "Cannot read for backup:\n" + path;
+    return false;
+  }
+  const qint64 size = src.size();
+  QByteArray buffer;
+  const uchar* data = size > 0 ? src.map(0, size) : nullptr;
+  if (!data && size > 0) {
+    buffer = src.readAll();
+    data = reinterpret_cast<const uchar*>(buffer.constData());
+  }
+  const char* bytes = reinterpret_cast<const char*>(data);
+
+  const QString store = storeDirFor(path);
+  const QString fileName = fi.fileName();
+  const QString fileHash = hexHash(bytes, size);
+
+  QMutexLocker lock(&storeMutex());
+
+  // Saved without changes since the last backup: nothing to record
+  QVector<Entry> entries = readIndex(store, fileName);
+  if (!entries.isEmpty() && entries.last().sha256 == fileHash) return true;
+
+  // Without trustworthy counts nothing is deleted (and no counts are written)
+  QHash<QString, int> refs;
+  const bool counted = readRefs(store, refs);
+
+  // Only chunks around the edits are new; they are compressed on the way in
+  QStringList chunks;
+  for (qint64 pos = 0; pos < size;) {
+    const qint64 n = chunkLength(data + pos, size - pos);
+    const char* chunk = bytes + pos;
+    const QString hash = hexHash(chunk, n);
+    chunks << hash;
+    pos += n;
+
+    const QString cp = chunkPath(store, hash);
+    if (QFileInfo::exists(cp)) continue; // stored by an earlier backup
+
+    QDir().mkpath(QFileInfo(cp).absolutePath());
+    const QByteArray packed = qCompress(reinterpret_cast<const uchar*>(chunk), qsizetype(n));
+    QSaveFile out(cp);
+    if (!out.open(QIODevice::WriteOnly) || out.write(packed) != packed.size() || !out.commit()) {
+      if (error) *error = "Cannot write backup chunk:\n" + cp;
+      return false;
+    }
+  }
+
+  // Tables also record their row count for the restore browser
+  qint64 rows = -1;
+  if (fi.suffix().compare("csv", Qt::CaseInsensitive) == 0) {
+    rows = std::max<qint64>(0, CsvTokenizer::indexRecords(bytes, size).size() - 1);
+  }
+
+  const QDateTime now = QDateTime::currentDateTime();
+  QJsonObject manifest;
+  manifest["file"] = fileName;
+  manifest["created"] = now.toString(Qt::ISODateWithMs);
+  manifest["size"] = double(size);
+  manifest["rows"] = double(rows);
+  manifest["sha256"] = fileHash;
+
+  // A delta against the previous backup, so the manifest also grows with the edit, not the table
+  QHash<QString, QStringList> memo;
+  QStringList baseChunks;
+  const int depth = entries.isEmpty() ? 0 : entries.last().depth + 1;
+  if (!entries.isEmpty() && depth < kKeyframeInterval &&
+      resolveChunks(entries.last().manifestPath, memo, baseChunks)) {
+    manifest["base"] = QFileInfo(entries.last().manifestPath).fileName();
+    manifest["depth"] = depth;
+    manifest["ops"] = diffChunks(baseChunks, chunks);
+  } else {
+    manifest["depth"] = 0;
+    manifest["chunks"] = QJsonArray::fromStringList(chunks);
+  }
+
+  // The manifest goes after its chunks and before the index entry: a listed backup has
+  // everything it needs
+  const QString dir = manifestDir(store, fileName);
+  const QString manifestPath = dir + "/" + now.toString("yyyy-MM-dd_HH-mm-ss-zzz") + ".json";
+  QDir().mkpath(dir);
+  if (!writeManifest(manifestPath, manifest)) {
+    if (error) *error = "Cannot write backup manifest:\n" + manifestPath;
+    return false;
+  }
+  entries.push_back(entryFrom(manifestPath, manifest));
+
+  // Counted before the backup is listed: a crash in between over-counts, which only keeps chunks
+  if (counted) {
+    for (const QString& c : QSet<QString>(chunks.cbegin(), chunks.cend())) ++refs[c];
+    if (!writeRefs(store, refs)) {
+      if (error) *error = "Cannot write backup chunk counts:\n" + refsPath(store);
+      return false;
+    }
+  }
+
+  // Keep the newest keepN. The oldest one kept becomes a keyframe before its bases go;
+  // chunks are deleted once no backup refers to them.
+  qsizetype extra = keepN > 0 ? std::max<qsizetype>(0, entries.size() - keepN) : 0;
+  QVector<QStringList> expired;
+  for (qsizetype i = 0; i < extra; ++i) {
+    QStringList list;
+    if (!resolveChunks(entries[i].manifestPath, memo, list)) list.clear(); // its chunks are leaked, not lost
+    expired.push_back(list);
+  }
+  if (extra > 0) {
+    Entry& oldest = entries[extra];
+    QJsonObject m = readManifest(oldest.manifestPath);
+    if (m.contains("ops")) {
+      QStringList list;
+      if (!resolveChunks(oldest.manifestPath, memo, list)) {
+        extra = 0; // leave the chain whole
+      } else {
+        m.remove("base");
+        m.remove("ops");
+        m["depth"] = 0;
+        m["chunks"] = QJsonArray::fromStringList(list);
+        if (writeManifest(oldest.manifestPath, m)) oldest.depth = 0;
+        else extra = 0;
+      }
+    }
+  }
+  for (qsizetype i = 0; i < extra; ++i) QFile::remove(entries[i].manifestPath);
+  entries.remove(0, extra);
+
+  if (!writeIndex(store, fileName, entries)) {
+    if (error) *error = "Cannot write backup index:\n" + indexPath(store, fileName);
+    return false;
+  }
+  if (!counted || extra == 0) return true;
+
+  // Only the expired backups' own chunks are looked at
+  QStringList unused;
+  for (qsizetype i = 0; i < extra; ++i) {
+    for (const QString& c : QSet<QString>(expired[i].cbegin(), expired[i].cend())) {
+      const auto it = refs.find(c);
+      if (it == refs.end() || --*it > 0) continue;
+      refs.erase(it);
+      unused << c;
+    }
+  }
+  // Counts first: a crash before the deletes leaves unreferenced chunks, never missing ones
+  if (!writeRefs(store, refs)) return true;
+  for (const QString& c : std::as_const(unused)) QFile::remove(chunkPath(store, c));
+  return true;
+}
+
+QVector<Entry> list(const QString& path) {
+  QMutexLocker lock(&storeMutex());
+  QVector<Entry> entries = readIndex(storeDirFor(path), QFileInfo(path).fileName());
+  std::reverse(entries.begin(), entries.end());
+  return entries;
+}
+
+bool restore(const QString& manifestPath, const QString& targetPath, QString* error) {
+  QMutexLocker lock(&storeMutex());
+
+  const QJsonObject manifest = readManifest(manifestPath);
+  QHash<QString, QStringList> memo;
+  QStringList chunks;
+  if (manifest.isEmpty() || !resolveChunks(manifestPath, memo, chunks)) {
+    if (error) *error = "Backup is damaged or incomplete:\n" + manifestPath;
+    return false;
+  }
+
+  const QString store = QDir::cleanPath(QFileInfo(manifestPath).absolutePath() + "/../..");
+  QCryptographicHash hash(QCryptographicHash::Sha256);
+  QSaveFile out(targetPath);
+  if (!out.open(QIODevice::WriteOnly)) {
+    if (error) *error = "Cannot write: " + targetPath;
+    return false;
+  }
+  for (const QString& c : std::as_const(chunks)) {
+    QFile f(chunkPath(store, c));
+    const QByteArray bytes = f.open(QIODevice::ReadOnly) ? qUncompress(f.readAll()) : QByteArray();
+    if (bytes.isEmpty() || out.write(bytes) != bytes.size()) {
+      if (error) *error = "Backup chunk missing or unreadable:\n" + c;
+      return false;
+    }
+    hash.addData(bytes);
+  }
+
+  // Only a byte-exact rebuild replaces the file
+  if (QString::fromLatin1(hash.result().toHex()) != manifest.value("sha256").toString()) {
+    if (error) *error = "Restored content does not match the backup:\n" + manifestPath;
+    return false;
+  }
+  if (!out.commit()) {
+    if (error) *error = "Cannot write: " + targetPath;
+    return false;
+  }
+  return true;
+}
+
+} // namespace BackupStore
@@ -0,0 +1,191 @@
+#include "ColumnarCsvStore.hpp"
+#include "NumberParser.hpp"
+
+#include <QHash>
+#include <QLocale>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+// A column is dictionary-encoded when each distinct value appears at least this often on average
+constexpr int kMinRepeats = 4;
+
+// Shortest text that reads back as the same double ("12.5", "-3", "1e+20")
+QByteArray formatNumber(double v) {
+  return QByteArray::number(v, 'g', QLocale::FloatingPointShortest);
+}
+
+} // namespace
+
+template <typename AppendCell>
+void ColumnarCsvStore::build(int rows, AppendCell&& appendCell) {
+  rows_ = rows;
+  columns_.resize(headers_.size());
+
+  QVector<int> cols(columns_.size());
+  std::iota(cols.begin(), cols.end(), 0);
+  QtConcurrent::blockingMap(cols, [this, rows, &appendCell](int c) {
+    Column& col = columns_[c];
+    col.offsets.resize(rows + 1);
+    for (int r = 0; r < rows; ++r) {
+      col.offsets[r] = quint32(col.arena.size());
+      appendCell(col.arena, r, c);
+    }
+    col.offsets[rows] = quint32(col.arena.size());
+    typeColumn(col, rows);
+  });
+}
+
+std::shared_ptr<ColumnarCsvStore> ColumnarCsvStore::fromIndex(const char* data, const CsvTokenizer::Index& idx,
+                                                              qsizetype rows) {
+  std::shared_ptr<ColumnarCsvStore> store(new ColumnarCsvStore());
+  if (idx.recordCount() == 0) return store;
+
+  store->headers_ = CsvTokenizer::decodeRecord(data, idx, 0);
+  store->build(int(rows), [data, &idx](QByteArray& arena, int r, int c) {
+    if (c < idx.fieldCount(r + 1)) CsvTokenizer::appendFieldUtf8(arena, data, idx.fields[idx.recordStart[r + 1] + c]);
+  });
+  return store;
+}
+
+std::shared_ptr<ColumnarCsvStore> ColumnarCsvStore::fromRows(const QStringList& headers,
+                                                             const QVector<QStringList>& rows) {
+  std::shared_ptr<ColumnarCsvStore> store(new ColumnarCsvStore());
+  store->headers_ = headers;
+  store->build(int(rows.size()), [&rows](QByteArray& arena, int r, int c) {
+    if (c < rows[r].size()) arena.append(rows[r][c].toUtf8());
+  });
+  return store;
+}
+
+void ColumnarCsvStore::typeColumn(Column& c, int rows) {
+  if (makeNumeric(c, rows) || makeDictionary(c, rows)) {
+    c.arena = QByteArray();
+    c.offsets = QVector<quint32>();
+  }
+}
+
+bool ColumnarCsvStore::makeNumeric(Column& c, int rows) {
+  QVector<double> values(rows);
+  QVector<quint64> present((rows + 63) / 64);
+
+  // One cell that is not a number (as the model reads numbers), or would not print back
+  // the same ("12.50", "12,5"), keeps it text
+  if (NumberParser::parseColumn(c.arena.constData(), c.offsets.constData(), rows, values.data(), present.data()) >= 0) {
+    return false;
+  }
+  bool any = false;
+  for (int r = 0; r < rows; ++r) {
+    if (!(present[r / 64] & (quint64(1) << (r % 64)))) continue;
+    const QByteArray text = QByteArray::fromRawData(c.arena.constData() + c.offsets[r],
+                                                    qsizetype(c.offsets[r + 1] - c.offsets[r]));
+    if (formatNumber(values[r]) != text) return false;
+    any = true;
+  }
+  if (!any) return false;
+
+  c.kind = Kind::Numeric;
+  c.values = std::move(values);
+  c.present = std::move(present);
+  return true;
+}
+
+bool ColumnarCsvStore::makeDictionary(Column& c, int rows) {
+  const qsizetype maxDistinct = std::min<qsizetype>(rows / kMinRepeats, std::numeric_limits<quint16>::max() + 1);
+  if (maxDistinct < 2) return false;
+
+  // Keys point into the arena, which outlives the hash
+  QHash<QByteArray, quint16> codeOf;
+  QVector<quint16> codes(rows);
+  for (int r = 0; r < rows; ++r) {
+    const QByteArray text = QByteArray::fromRawData(c.arena.constData() + c.offsets[r],
+                                                    qsizetype(c.offsets[r + 1] - c.offsets[r]));
+    auto it = codeOf.constFind(text);
+    if (it == codeOf.constEnd()) {
+      if (codeOf.size() == maxDistinct) return false; // too many distinct values to pay off
+      it = codeOf.insert(text, quint16(codeOf.size()));
+    }
+    codes[r] = *it;
+  }
+
+  c.dictionary.resize(codeOf.size());
+  c.dictUtf8.resize(codeOf.size());
+  for (auto it = codeOf.cbegin(); it != codeOf.cend(); ++it) {
+    c.dictUtf8[it.value()] = QByteArray(it.key().constData(), it.key().size()); // deep copy: arena goes away
+    c.dictionary[it.value()] = QString::fromUtf8(it.key());
+  }
+  c.kind = Kind::Dictionary;
+  c.codes = std::move(codes);
+  return true;
+}
+
+const QStringList* ColumnarCsvStore::dictionary(int col) const {
+  if (col < 0 || col >= columns_.size() || columns_[col].kind != Kind::Dictionary) return nullptr;
+  return &columns_[col].dictionary;
+}
+
+int ColumnarCsvStore::dictionaryCode(int row, int col) const {
+  if (row < 0 || row >= rows_ || col < 0 || col >= columns_.size()) return -1;
+  const Column& c = columns_[col];
+  return c.kind == Kind::Dictionary ? c.codes[row] : -1;
+}
+
+bool ColumnarCsvStore::number(int row, int col, double& out) const {
+  if (row < 0 || row >= rows_ || !isNumeric(col)) return false;
+  const Column& c = columns_[col];
+  if (!(c.present[row / 64] & (quint64(1) << (row % 64)))) return false;
+  out = c.values[row];
+  return true;
+}
+
+qint64 ColumnarCsvStore::memoryBytes() const {
+  qint64 bytes = 0;
+  for (const Column& c : columns_) {
+    bytes += c.arena.size() + c.offsets.size() * qint64(sizeof(quint32));
+    bytes += c.values.size() * qint64(sizeof(double)) + c.present.size() * qint64(sizeof(quint64));
+    bytes += c.codes.size() * qint64(sizeof(quint16));
+    for (const QByteArray& v : c.dictUtf8) bytes += v.size() * 3; // UTF-8 plus the QString copy
+  }
+  return bytes;
+}
+
+bool ColumnarCsvStore::viewUtf8(int row, int col, QByteArrayView& out) const {
+  if (row < 0 || row >= rows_ || col < 0 || col >= columns_.size() || columns_[col].kind != Kind::Text) return false;
+  const Column& c = columns_[col];
+  out = QByteArrayView(c.arena.constData() + c.offsets[row], qsizetype(c.offsets[row + 1] - c.offsets[row]));
+  return true;
+}
+
+QString ColumnarCsvStore::cell(int row, int col) const {
+  if (row < 0 || row >= rows_ || col < 0 || col >= columns_.size()) return {};
+  const Column& c = columns_[col];
+  if (c.kind == Kind::Dictionary) return c.dictionary[c.codes[row]];
+  if (c.kind == Kind::Numeric) {
+    double v = 0.0;
+    return number(row, col, v) ? QString::fromLatin1(formatNumber(v)) : QString();
+  }
+  return QString::fromUtf8(c.arena.constData() + c.offsets[row], qsizetype(c.offsets[row + 1] - c.offsets[row]));
+}
+
+void ColumnarCsvStore::writeCell(int row, int col, CsvCellSink& sink) const {
+  if (row < 0 || row >= rows_ || col < 0 || col >= columns_.size()) {
+    sink.text({});
+    return;
+  }
+  const Column& c = columns_[col];
+  if (c.kind == Kind::Dictionary) {
+    sink.utf8(c.dictUtf8[c.codes[row]]);
+    return;
+  }
+  if (c.kind == Kind::Numeric) {
+    double v = 0.0;
+    if (number(row, col, v)) sink.utf8(formatNumber(v));
+    else sink.text({});
+    return;
+  }
+  sink.utf8(QByteArrayView(c.arena.constData() + c.offsets[row], qsizetype(c.offsets[row + 1] - c.offsets[row])));
+}
@@ -0,0 +1,406 @@
+#include "CsvCache.hpp"
+#include "ColumnarCsvStore.hpp"
+#include "CsvTokenizer.hpp"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QSaveFile>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// On-disk layout, host byte order (a foreign cache simply fails the magic check):
+//   per column, 8-byte aligned: u32 name length + UTF-8 name | u32 offsets[rows + 1] | UTF-8 blob
+//     numeric columns then:     f64 values[rows] | u64 present bits[(rows + 63) / 64]
+//     dictionary columns then:  u32 count + u32 offsets[count + 1] + UTF-8 values | u16 codes[rows]
+//   ColumnEntry[columns]
+//   Trailer
+// The trailer sits at the end so the whole file can be written in one streaming pass.
+// Column kinds are ColumnarCsvStore's, so a warm start gets the same typed columns as a parse;
+// the text stays too, so cells are still written back byte for byte.
+constexpr char kMagic[8] = {'P', 'B', 'C', 'S', 'V', 'C', '\0', '\1'};
+constexpr quint32 kVersion = 2;
+
+enum ColumnKind : quint64 { kText = 0, kNumeric = 1, kDictionary = 2 };
+
+struct ColumnEntry {
+  quint64 nameOffset;
+  quint64 offsetsOffset;
+  quint64 blobOffset;
+  quint64 blobBytes;
+  quint64 kind;        // ColumnKind
+  quint64 typedOffset; // numeric: values, then present bits; dictionary: codes
+  quint64 dictOffset;  // dictionary values
+  quint64 dictBytes;
+};
+
+struct Trailer {
+  char magic[8];
+  quint32 version;
+  quint32 columns;
+  quint64 rows;
+  quint64 directoryOffset;
+  qint64 csvSize;
+  qint64 csvMtime;  // ms since epoch
+  char csvHash[16]; // MD5 of the CSV bytes
+};
+
+bool fits(quint64 offset, quint64 bytes, quint64 size) {
+  return offset <= size && bytes <= size - offset;
+}
+
+// Same size but a new mtime (copied, touched, saved unchanged): the content hash decides
+bool sameContent(const QString& csvPath, const char* hash) {
+  QFile f(csvPath);
+  if (!f.open(QIODevice::ReadOnly)) return false;
+  QCryptographicHash h(QCryptographicHash::Md5);
+  if (!h.addData(&f)) return false;
+  return std::memcmp(h.result().constData(), hash, 16) == 0;
+}
+
+class CachedCsvStore : public CsvBackingStore {
+public:
+  bool open(const QString& cachePath, const QFileInfo& csv);
+
+  QStringList headers() const override { return headers_; }
+  int rowCount() const override { return rows_; }
+  int columnCount() const override { return headers_.size(); }
+  QString cell(int row, int col) const override;
+  void writeCell(int row, int col, CsvCellSink& sink) const override;
+  bool viewUtf8(int row, int col, QByteArrayView& out) const override;
+  bool number(int row, int col, double& out) const override;
+  const QStringList* dictionary(int col) const override;
+  int dictionaryCode(int row, int col) const override;
+
+  qint64 memoryBytes() const override { return file_.size(); }
+
+private:
+  struct Column {
+    ColumnKind kind = kText;
+    const quint32* offsets = nullptr;
+    const char* blob = nullptr;
+    const double* values = nullptr;   // numeric
+    const quint64* present = nullptr; // numeric: clear = empty cell
+    const quint16* codes = nullptr;   // dictionary
+    QStringList dictionary;
+  };
+
+  static bool readDictionary(const uchar* base, quint64 size, const ColumnEntry& e, QStringList& out);
+
+  QFile file_;
+  QStringList headers_;
+  QVector<Column> columns_;
+  int rows_ = 0;
+};
+
+bool CachedCsvStore::open(const QString& cachePath, const QFileInfo& csv) {
+  file_.setFileName(cachePath);
+  if (!file_.open(QIODevice::ReadOnly)) return false;
+
+  const quint64 size = quint64(file_.size());
+  if (size < sizeof(Trailer)) return false;
+  const uchar* base = file_.map(0, qint64(size));
+  if (!base) return false;
+
+  Trailer t;
+  std::memcpy(&t, base + size - sizeof(Trailer), sizeof(Trailer));
+  if (std::memcmp(t.magic, kMagic, sizeof(kMagic)) != 0 || t.version != kVersion) return false;
+  if (t.csvSize != csv.size() || t.rows >= quint64(std::numeric_limits<int>::max())) return false;
+  if (t.csvMtime != csv.lastModified().toMSecsSinceEpoch() && !sameContent(csv.filePath(), t.csvHash)) return false;
+  if (!fits(t.directoryOffset, quint64(t.columns) * sizeof(ColumnEntry), size)) return false;
+
+  // Bounds-check everything once so a damaged cache can never send cell() out of the mapping
+  const quint64 offsetsBytes = (t.rows + 1) * sizeof(quint32);
+  for (quint32 c = 0; c < t.columns; ++c) {
+    ColumnEntry e;
+    std::memcpy(&e, base + t.directoryOffset + c * sizeof(ColumnEntry), sizeof(ColumnEntry));
+
+    quint32 nameBytes = 0;
+    if (!fits(e.nameOffset, sizeof(quint32), size)) return false;
+    std::memcpy(&nameBytes, base + e.nameOffset, sizeof(quint32));
+    if (!fits(e.nameOffset + sizeof(quint32), nameBytes, size)) return false;
+    if (e.offsetsOffset % alignof(quint32) != 0 || !fits(e.offsetsOffset, offsetsBytes, size)) return false;
+    if (!fits(e.blobOffset, e.blobBytes, size)) return false;
+
+    Column col;
+    col.offsets = reinterpret_cast<const quint32*>(base + e.offsetsOffset);
+    col.blob = reinterpret_cast<const char*>(base + e.blobOffset);
+    if (col.offsets[0] != 0 || col.offsets[t.rows] > e.blobBytes) return false;
+    for (quint64 r = 0; r < t.rows; ++r) {
+      if (col.offsets[r + 1] < col.offsets[r]) return false;
+    }
+
+    col.kind = ColumnKind(e.kind);
+    if (col.kind == kNumeric) {
+      const quint64 words = (t.rows + 63) / 64;
+      if (e.typedOffset % alignof(double) != 0 || !fits(e.typedOffset, (t.rows + words) * 8, size)) return false;
+      col.values = reinterpret_cast<const double*>(base + e.typedOffset);
+      col.present = reinterpret_cast<const quint64*>(base + e.typedOffset + t.rows * sizeof(double));
+    } else if (col.kind == kDictionary) {
+      if (!readDictionary(base, size, e, col.dictionary)) return false;
+      if (e.typedOffset % alignof(quint16) != 0 || !fits(e.typedOffset, t.rows * sizeof(quint16), size)) return false;
+      col.codes = reinterpret_cast<const quint16*>(base + e.typedOffset);
+      for (quint64 r = 0; r < t.rows; ++r) {
+        if (col.codes[r] >= col.dictionary.size()) return false;
+      }
+    } else if (col.kind != kText) {
+      return false;
+    }
+
+    headers_.push_back(QString::fromUtf8(reinterpret_cast<const char*>(base + e.nameOffset + sizeof(quint32)),
+                                         qsizetype(nameBytes)));
+    columns_.push_back(col);
+  }
+
+  rows_ = int(t.rows);
+  return !headers_.isEmpty();
+}
+
+bool CachedCsvStore::readDictionary(const uchar* base, quint64 size, const ColumnEntry& e, QStringList& out) {
+  if (!fits(e.dictOffset, e.dictBytes, size) || e.dictBytes < sizeof(quint32)) return false;
+  const uchar* p = base + e.dictOffset;
+  quint32 count = 0;
+  std::memcpy(&count, p, sizeof(quint32));
+  const quint64 offsetsBytes = (quint64(count) + 1) * sizeof(quint32);
+  if (offsetsBytes > e.dictBytes - sizeof(quint32)) return false;
+
+  const uchar* values = p + sizeof(quint32) + offsetsBytes;
+  const quint64 valueBytes = e.dictBytes - sizeof(quint32) - offsetsBytes;
+  quint32 prev = 0;
+  out.reserve(count);
+  for (quint32 i = 0; i < count; ++i) {
+    quint32 begin = 0, end = 0;
+    std::memcpy(&begin, p + sizeof(quint32) + i * sizeof(quint32), sizeof(quint32));
+    std::memcpy(&end, p + sizeof(quint32) + (i + 1) * sizeof(quint32), sizeof(quint32));
+    if (begin != prev || end < begin || end > valueBytes) return false;
+    out.push_back(QString::fromUtf8(reinterpret_cast<const char*>(values + begin), qsizetype(end - begin)));
+    prev = end;
+  }
+  return true;
+}
+
+QString CachedCsvStore::cell(int row, int col) const {
+  if (row < 0 || row >= rows_ || col < 0 || col >= columns_.size()) return {};
+  const Column& c = columns_[col];
+  if (c.kind == kDictionary) return c.dictionary[c.codes[row]]; // shared, no decoding
+  return QString::fromUtf8(c.blob + c.offsets[row], qsizetype(c.offsets[row + 1] - c.offsets[row]));
+}
+
+bool CachedCsvStore::viewUtf8(int row, int col, QByteArrayView& out) const {
+  if (row < 0 || row >= rows_ || col < 0 || col >= columns_.size()) return false;
+  const Column& c = columns_[col];
+  out = QByteArrayView(c.blob + c.offsets[row], qsizetype(c.offsets[row + 1] - c.offsets[row]));
+  return true;
+}
+
+void CachedCsvStore::writeCell(int row, int col, CsvCellSink& sink) const {
+  if (row < 0 || row >= rows_ || col < 0 || col >= columns_.size()) {
+    sink.text({});
+    return;
+  }
+  const Column& c = columns_[col];
+  sink.utf8(QByteArrayView(c.blob + c.offsets[row], qsizetype(c.offsets[row + 1] - c.offsets[row])));
+}
+
+bool CachedCsvStore::number(int row, int col, double& out) const {
+  if (row < 0 || row >= rows_ || col < 0 || col >= columns_.size()) return false;
+  const Column& c = columns_[col];
+  if (c.kind != kNumeric || !(c.present[row / 64] & (quint64(1) << (row % 64)))) return false;
+  out = c.values[row];
+  return true;
+}
+
+const QStringList* CachedCsvStore::dictionary(int col) const {
+  if (col < 0 || col >= columns_.size() || columns_[col].kind != kDictionary) return nullptr;
+  return &columns_[col].dictionary;
+}
+
+int CachedCsvStore::dictionaryCode(int row, int col) const {
+  if (row < 0 || row >= rows_ || col < 0 || col >= columns_.size()) return -1;
+  const Column& c = columns_[col];
+  return c.kind == kDictionary ? c.codes[row] : -1;
+}
+
+QMutex& pendingMutex() {
+  static QMutex m;
+  return m;
+}
+
+// csv path -> "changed again while building" flag
+QHash<QString, bool>& pendingBuilds() {
+  static QHash<QString, bool> pending;
+  return pending;
+}
+
+} // namespace
+
+namespace CsvCache {
+
+QString cachePathFor(const QString& csvPath) {
+  return csvPath + ".cache";
+}
+
+std::shared_ptr<const CsvBackingStore> open(const QString& csvPath) {
+  const QFileInfo csv(csvPath);
+  if (!csv.exists() || !QFileInfo::exists(cachePathFor(csvPath))) return nullptr;
+
+  auto store = std::make_shared<CachedCsvStore>();
+  if (!store->open(cachePathFor(csvPath), csv)) return nullptr;
+  return store;
+}
+
+bool build(const QString& csvPath) {
+  const QFileInfo before(csvPath);
+  if (!before.exists()) return false;
+
+  QFile csv(csvPath);
+  if (!csv.open(QIODevice::ReadOnly)) return false;
+  const qint64 size = csv.size();
+  const char* data = size > 0 ? reinterpret_cast<const char*>(csv.map(0, size)) : nullptr;
+  if (!data) return false;
+
+  const CsvTokenizer::Index idx = CsvTokenizer::tokenize(data, size);
+  if (idx.recordCount() == 0) return false;
+
+  Trailer t{};
+  std::memcpy(t.magic, kMagic, sizeof(kMagic));
+  t.version = kVersion;
+  t.columns = quint32(idx.fieldCount(0));
+  t.rows = quint64(idx.recordCount() - 1);
+  t.csvSize = size;
+  t.csvMtime = before.lastModified().toMSecsSinceEpoch();
+  const QByteArray hash = QCryptographicHash::hash(QByteArray::fromRawData(data, qsizetype(size)),
+                                                    QCryptographicHash::Md5);
+  std::memcpy(t.csvHash, hash.constData(), sizeof(t.csvHash));
+
+  QSaveFile out(cachePathFor(csvPath));
+  if (!out.open(QIODevice::WriteOnly)) return false;
+
+  bool ok = true;
+  quint64 pos = 0;
+  auto write = [&](const void* p, qint64 n) {
+    if (ok && out.write(static_cast<const char*>(p), n) != n) ok = false;
+    pos += quint64(n);
+  };
+  auto align = [&] {
+    static const char zeros[8] = {};
+    write(zeros, qint64((8 - pos % 8) % 8));
+  };
+
+  // Typed the way a parse types it: numeric and dictionary payloads come from that store
+  const auto typed = ColumnarCsvStore::fromIndex(data, idx, qsizetype(t.rows));
+
+  QVector<ColumnEntry> directory(t.columns);
+  QVector<quint32> offsets(qsizetype(t.rows + 1));
+  QByteArray blob;
+
+  for (quint32 c = 0; c < t.columns && ok; ++c) {
+    ColumnEntry& e = directory[c];
+
+    QByteArray name;
+    CsvTokenizer::appendFieldUtf8(name, data, idx.fields[idx.recordStart[0] + c]);
+    const quint32 nameBytes = quint32(name.size());
+    e.nameOffset = pos;
+    write(&nameBytes, sizeof(nameBytes));
+    write(name.constData(), name.size());
+    align();
+
+    blob.clear();
+    for (qsizetype r = 1; r < idx.recordCount(); ++r) {
+      offsets[r - 1] = quint32(blob.size());
+      if (c < idx.fieldCount(r)) CsvTokenizer::appendFieldUtf8(blob, data, idx.fields[idx.recordStart[r] + c]);
+      if (quint64(blob.size()) > std::numeric_limits<quint32>::max()) ok = false; // column too big for u32 offsets
+    }
+    offsets[qsizetype(t.rows)] = quint32(blob.size());
+
+    e.offsetsOffset = pos;
+    write(offsets.constData(), offsets.size() * qint64(sizeof(quint32)));
+    align();
+
+    e.blobOffset = pos;
+    e.blobBytes = quint64(blob.size());
+    write(blob.constData(), blob.size());
+    align();
+
+    const int tc = int(c);
+    const QStringList* dict = tc < typed->columnCount() ? typed->dictionary(tc) : nullptr;
+    e.kind = tc < typed->columnCount() && typed->isNumeric(tc) ? kNumeric : dict ? kDictionary : kText;
+    if (e.kind == kNumeric) {
+      QVector<double> values(qsizetype(t.rows), 0.0);
+      QVector<quint64> present(qsizetype((t.rows + 63) / 64), 0);
+      for (int r = 0; r < int(t.rows); ++r) {
+        if (typed->number(r, tc, values[r])) present[r / 64] |= quint64(1) << (r % 64);
+      }
+      e.typedOffset = pos;
+      write(values.constData(), values.size() * qint64(sizeof(double)));
+      write(present.constData(), present.size() * qint64(sizeof(quint64)));
+    } else if (e.kind == kDictionary) {
+      QByteArray utf8;
+      QVector<quint32> valueOffsets{0};
+      for (const QString& v : *dict) {
+        utf8 += v.toUtf8();
+        valueOffsets.push_back(quint32(utf8.size()));
+      }
+      const quint32 count = quint32(dict->size());
+      e.dictOffset = pos;
+      write(&count, sizeof(count));
+      write(valueOffsets.constData(), valueOffsets.size() * qint64(sizeof(quint32)));
+      write(utf8.constData(), utf8.size());
+      e.dictBytes = pos - e.dictOffset;
+      align();
+
+      QVector<quint16> codes(qsizetype(t.rows));
+      for (int r = 0; r < int(t.rows); ++r) codes[r] = quint16(typed->dictionaryCode(r, tc));
+      e.typedOffset = pos;
+      write(codes.constData(), codes.size() * qint64(sizeof(quint16)));
+    }
+    align();
+  }
+
+  t.directoryOffset = pos;
+  write(directory.constData(), directory.size() * qint64(sizeof(ColumnEntry)));
+  write(&t, sizeof(t));
+
+  // The CSV was replaced while we were reading it: this snapshot is already stale
+  const QFileInfo after(csvPath);
+  if (!ok || after.size() != size || after.lastModified() != before.lastModified()) {
+    out.cancelWriting();
+    return false;
+  }
+  return out.commit();
+}
+
+void rebuildInBackground(const QString& csvPath) {
+  {
+    QMutexLocker lock(&pendingMutex());
+    auto it = pendingBuilds().find(csvPath);
+    if (it != pendingBuilds().end()) {
+      *it = true; // the running build will go again
+      return;
+    }
+    pendingBuilds().insert(csvPath, false);
+  }
+
+  (void)QtConcurrent::run([csvPath] {
+    while (true) {
+      build(csvPath);
+
+      QMutexLocker lock(&pendingMutex());
+      auto it = pendingBuilds().find(csvPath);
+      if (!*it) {
+        pendingBuilds().erase(it);
+        return;
+      }
+      *it = false;
+    }
+  });
+}
+
+} // namespace CsvCache
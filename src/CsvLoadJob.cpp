@@ -0,0 +1,174 @@
+#include "CsvLoadJob.hpp"
+#include "ColumnarCsvStore.hpp"
+#include "CsvCache.hpp"
+#include "CsvTokenizer.hpp"
+#include "MappedCsvStore.hpp"
+#include "TableStorage.hpp"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+
+namespace {
+
+// Files at least this big are memory-mapped and decoded lazily instead of parsed up front
+constexpr qint64 kMappedLoadThreshold = 32 * 1024 * 1024;
+
+// Head of a big file parsed for the first screen while the rest is indexed
+constexpr qint64 kPreviewBytes = 256 * 1024;
+
+// Parsed text is published in batches that grow 4x each time
+constexpr qsizetype kFirstBatchRows = 512;
+
+struct MappedFile {
+  QFile file;
+  QByteArray buffer; // fallback when mapping is not possible
+  const char* data = nullptr;
+  qint64 size = 0;
+
+  bool open(const QString& path, QString* error) {
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+      if (error) *error = file.errorString();
+      return false;
+    }
+    size = file.size();
+    data = size > 0 ? reinterpret_cast<const char*>(file.map(0, size)) : nullptr;
+    if (!data && size > 0) {
+      buffer = file.readAll();
+      data = buffer.constData();
+      size = buffer.size();
+    }
+    return true;
+  }
+};
+
+// Complete records from the head of the file; the last one may be cut off, so it is dropped
+std::shared_ptr<const CsvBackingStore> previewStore(const char* data, qint64 size) {
+  const qint64 head = std::min(size, kPreviewBytes);
+  const CsvTokenizer::Index idx = CsvTokenizer::tokenize(data, head);
+  const qsizetype rows = idx.recordCount() - (head < size ? 2 : 1);
+  if (rows < 0) return nullptr;
+  return ColumnarCsvStore::fromIndex(data, idx, rows);
+}
+
+// Next load maps a binary cache instead of parsing; only worth it while the CSVs are the tables
+// (the paged store reads a CSV once, to import it)
+void cacheForNextLoad(const QString& path) {
+  if (TableStorage::instance().usesCsvFiles()) CsvCache::rebuildInBackground(path);
+}
+
+} // namespace
+
+CsvLoadJob::CsvLoadJob(QObject* context, Callback onUpdate)
+  : context_(context), onUpdate_(std::move(onUpdate)) {}
+
+std::shared_ptr<CsvLoadJob> CsvLoadJob::start(const QString& path, QObject* context, Callback onUpdate) {
+  std::shared_ptr<CsvLoadJob> job(new CsvLoadJob(context, std::move(onUpdate)));
+  (void)QtConcurrent::run([job, path] { job->run(path); });
+  return job;
+}
+
+std::shared_ptr<CsvLoadJob> CsvLoadJob::startWith(Loader load, QObject* context, Callback onUpdate) {
+  std::shared_ptr<CsvLoadJob> job(new CsvLoadJob(context, std::move(onUpdate)));
+  (void)QtConcurrent::run([job, load = std::move(load)] {
+    Update done;
+    done.percent = 100;
+    done.final = true;
+    if (!job->cancelled_) done.store = load(&done.error);
+    job->publish(done);
+  });
+  return job;
+}
+
+void CsvLoadJob::publish(Update u) {
+  if (cancelled_) return;
+  auto self = shared_from_this();
+  QMetaObject::invokeMethod(QCoreApplication::instance(), [self, u = std::move(u)] {
+    if (!self->cancelled_ && self->context_) self->onUpdate_(u);
+  }, Qt::QueuedConnection);
+}
+
+void CsvLoadJob::run(const QString& path) {
+  Update done;
+  done.percent = 100;
+  done.final = true;
+
+  if (!QFile::exists(path)) {
+    publish(done);
+    return;
+  }
+
+  // Binary sidecar still matches the CSV: map it, nothing to parse
+  if ((done.store = CsvCache::open(path))) {
+    publish(done);
+    return;
+  }
+
+  MappedFile f;
+  if (!f.open(path, &done.error)) {
+    publish(done);
+    return;
+  }
+
+  if (f.size >= kMappedLoadThreshold) {
+    // Big files stay mapped: show the head now, then index the records of the whole file
+    Update preview;
+    preview.store = previewStore(f.data, f.size);
+    preview.percent = 5;
+    publish(preview);
+    if (cancelled_) return;
+
+    done.store = MappedCsvStore::open(path, &done.error);
+    publish(done);
+    if (done.store) cacheForNextLoad(path);
+    return;
+  }
+
+  const CsvTokenizer::Index idx = CsvTokenizer::tokenize(f.data, f.size);
+  if (idx.recordCount() == 0) {
+    publish(done);
+    return;
+  }
+
+  const qsizetype total = idx.recordCount() - 1;
+  qsizetype rows = 0;
+
+  qsizetype batch = kFirstBatchRows;
+  do {
+    if (cancelled_) return;
+
+    // Every batch is a fresh columnar store over all rows so far (4x growth keeps this linear)
+    rows = std::min(total, rows + batch);
+    batch *= 4;
+
+    Update u;
+    u.store = ColumnarCsvStore::fromIndex(f.data, idx, rows);
+    u.final = rows == total;
+    u.percent = total > 0 ? int(rows * 100 / total) : 100;
+    publish(u);
+  } while (rows < total);
+
+  cacheForNextLoad(path);
+}
+
+std::shared_ptr<const CsvBackingStore> CsvLoadJob::loadNow(const QString& path, QString* error) {
+  if (!QFile::exists(path)) return nullptr;
+  if (auto cached = CsvCache::open(path)) return cached;
+
+  MappedFile f;
+  if (!f.open(path, error)) return nullptr;
+
+  std::shared_ptr<const CsvBackingStore> store;
+  if (f.size >= kMappedLoadThreshold) {
+    store = MappedCsvStore::open(path, error);
+  } else {
+    const CsvTokenizer::Index idx = CsvTokenizer::tokenize(f.data, f.size);
+    if (idx.recordCount() > 0) store = ColumnarCsvStore::fromIndex(f.data, idx, idx.recordCount() - 1);
+  }
+
+  if (store) cacheForNextLoad(path);
+  return store;
+}
@@ -1,12 +1,26 @@
 #include "CsvTableModel.hpp"
+#include "ColumnarCsvStore.hpp"
 
-#include <QRegularExpression>
+#include "NumberParser.hpp"
+#include "ParallelSort.hpp"
+#include "TrigramIndex.hpp"
+
+#include <QCollator>
+#include <QFutureWatcher>
+#include <QSet>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+#include <numeric>
+
+// Removing more separate runs than this resets the model instead of signalling each run
+static constexpr int kMaxRemoveSignals = 32;
 
 CsvTableModel::CsvTableModel(QObject* parent) : QAbstractTableModel(parent) {}
 
 int CsvTableModel::rowCount(const QModelIndex& parent) const {
   if (parent.isValid()) return 0;
-  return rows_.size();
+  return rowIds_.size();
 }
 
 int CsvTableModel::columnCount(const QModelIndex& parent) const {
@@ -20,12 +34,257 @@ QVariant CsvTableModel::data(const QModelIndex& index, int role) const {
 
   const int r = index.row();
   const int c = index.column();
-  if (r < 0 || r >= rows_.size()) return {};
+  if (r < 0 || r >= rowIds_.size()) return {};
   if (c < 0 || c >= headers_.size()) return {};
 
-  const auto& row = rows_[r];
-  if (c >= row.size()) return {};
-  return row[c];
+  return cellText(r, c);
+}
+
+QString CsvTableModel::cellText(int row, int col) const {
+  return textOf(rowIds_[row], colIds_[col]);
+}
+
+bool CsvTableModel::cellNumber(int row, int col, double& out) const {
+  return numberIn(store_.get(), overlay_, rowIds_[row], colIds_[col], out);
+}
+
+QString CsvTableModel::textIn(const CsvBackingStore* store, const QHash<quint64, QString>& overlay,
+                              int rowId, int colId) {
+  if (!overlay.isEmpty()) {
+    const auto it = overlay.constFind(cellKey(rowId, colId));
+    if (it != overlay.constEnd()) return *it;
+  }
+  if (store && rowId < store->rowCount() && colId < store->columnCount()) {
+    return store->cell(rowId, colId);
+  }
+  return {};
+}
+
+bool CsvTableModel::numberIn(const CsvBackingStore* store, const QHash<quint64, QString>& overlay,
+                             int rowId, int colId, double& out) {
+  const bool edited = !overlay.isEmpty() && overlay.contains(cellKey(rowId, colId));
+  if (!edited && store && rowId < store->rowCount()) {
+    if (store->number(rowId, colId, out)) return true;
+    QByteArrayView utf8;
+    if (store->viewUtf8(rowId, colId, utf8)) return NumberParser::parse(utf8, out); // no QString
+  }
+  return parseNumber(textIn(store, overlay, rowId, colId), out);
+}
+
+int CsvTableModel::codeIn(const CsvBackingStore* store, const QHash<quint64, QString>& overlay,
+                          int rowId, int colId) {
+  if (!store) return -1;
+  if (!overlay.isEmpty() && overlay.contains(cellKey(rowId, colId))) return -1;
+  return store->dictionaryCode(rowId, colId);
+}
+
+const QStringList* CsvTableModel::dictionary(int col) const {
+  if (!store_ || col < 0 || col >= colIds_.size()) return nullptr;
+  return store_->dictionary(colIds_[col]);
+}
+
+int CsvTableModel::dictionaryCode(int row, int col) const {
+  if (row < 0 || row >= rowIds_.size() || col < 0 || col >= colIds_.size()) return -1;
+  return codeIn(store_.get(), overlay_, rowIds_[row], colIds_[col]);
+}
+
+QVector<int> CsvTableModel::sortRanks(int col) const {
+  if (col < 0 || col >= headers_.size()) return {};
+
+  const int colId = colIds_[col];
+  const bool numeric = isNumericColumn(col);
+  SortCache& cache = sortCache_[colId];
+  if (cache.rowsVersion == rowsVersion_ && cache.colVersion == colVersions_.value(colId) &&
+      cache.numeric == numeric && cache.ranks.size() == rowIds_.size()) {
+    return cache.ranks;
+  }
+
+  const int rows = rowIds_.size();
+  QVector<int> order(rows);
+  std::iota(order.begin(), order.end(), 0);
+
+  // Keys are computed once per row (in parallel), so comparisons are plain value compares
+  QVector<int> slices;
+  for (int from = 0; from < rows; from += ParallelSort::kMinParallelItems) slices.push_back(from);
+  auto eachSlice = [&](auto&& fn) {
+    QtConcurrent::blockingMap(slices, [&](int from) {
+      const int to = std::min(rows, from + int(ParallelSort::kMinParallelItems));
+      fn(from, to);
+    });
+  };
+
+  if (numeric) {
+    struct Key {
+      bool valid;
+      double value;
+    };
+    QVector<Key> keys(rows);
+    Key* out = keys.data();
+    eachSlice([&](int from, int to) {
+      for (int r = from; r < to; ++r) {
+        double v = 0.0;
+        const bool ok = cellNumber(r, col, v);
+        out[r] = {ok, v};
+      }
+    });
+    ParallelSort::stableSort(order, [&keys](int a, int b) {
+      const Key& x = keys[a];
+      const Key& y = keys[b];
+      if (x.valid != y.valid) return x.valid; // empty / non-numeric cells last
+      return x.valid && x.value < y.value;
+    });
+  } else {
+    auto makeCollator = [] {
+      QCollator collator;
+      collator.setCaseSensitivity(Qt::CaseInsensitive);
+      collator.setNumericMode(true); // "M2" before "M10"
+      return collator;
+    };
+
+    // Dictionary values are keyed once and shared by every row that uses them
+    const QStringList* dict = dictionary(col);
+    QVector<QCollatorSortKey> dictKeys;
+    if (dict) {
+      const QCollator collator = makeCollator();
+      dictKeys.reserve(dict->size());
+      for (const QString& v : *dict) dictKeys.push_back(collator.sortKey(v));
+    }
+
+    // QCollatorSortKey has no default constructor: each slice builds its own run, then they are joined
+    QVector<QVector<QCollatorSortKey>> parts(slices.size());
+    eachSlice([&](int from, int to) {
+      const QCollator collator = makeCollator(); // one per thread
+      QVector<QCollatorSortKey>& part = parts[from / ParallelSort::kMinParallelItems];
+      part.reserve(to - from);
+      for (int r = from; r < to; ++r) {
+        const int code = dict ? dictionaryCode(r, col) : -1;
+        part.push_back(code >= 0 ? dictKeys[code] : collator.sortKey(cellText(r, col)));
+      }
+    });
+    QVector<QCollatorSortKey> keys;
+    keys.reserve(rows);
+    for (const auto& part : parts) keys.append(part);
+
+    ParallelSort::stableSort(order, [&keys](int a, int b) { return keys[a].compare(keys[b]) < 0; });
+  }
+
+  QVector<int> ranks(rows);
+  for (int i = 0; i < rows; ++i) ranks[order[i]] = i;
+
+  cache = {rowsVersion_, colVersions_.value(colId), numeric, ranks};
+  return ranks;
+}
+
+void CsvTableModel::dropSearchIndex() {
+  searchIndex_.reset();
+  searchIndexBuilding_ = false;
+  unindexedRows_.clear();
+  ++searchIndexBuild_;
+}
+
+void CsvTableModel::rebuildSearchIndex() {
+  dropSearchIndex();
+  if (!store_) return;
+
+  // Store cells are indexed on the worker; edited cells are added here once it is done
+  for (auto it = overlay_.cbegin(); it != overlay_.cend(); ++it) unindexedRows_.insert(int(it.key() >> 32));
+  searchIndexBuilding_ = true;
+
+  const quint64 build = searchIndexBuild_;
+  auto* watcher = new QFutureWatcher<std::shared_ptr<TrigramIndex>>(this);
+  connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, build] {
+    watcher->deleteLater();
+    if (build != searchIndexBuild_) return;
+
+    searchIndex_ = watcher->result();
+    searchIndexBuilding_ = false;
+    for (const int rowId : std::as_const(unindexedRows_)) {
+      for (const int colId : std::as_const(colIds_)) searchIndex_->add(rowId, textOf(rowId, colId));
+    }
+    unindexedRows_.clear();
+  });
+  watcher->setFuture(QtConcurrent::run([store = store_] { return TrigramIndex::build(*store); }));
+}
+
+const QVector<int>& CsvTableModel::rowPositions() const {
+  if (rowPosVersion_ != rowsVersion_) {
+    rowPos_.fill(-1, nextRowId_);
+    for (int r = 0; r < rowIds_.size(); ++r) rowPos_[rowIds_[r]] = r;
+    rowPosVersion_ = rowsVersion_;
+  }
+  return rowPos_;
+}
+
+int CsvTableModel::rowOfId(int rowId) const {
+  const QVector<int>& pos = rowPositions();
+  return rowId >= 0 && rowId < pos.size() ? pos[rowId] : -1;
+}
+
+bool CsvTableModel::searchCandidates(const QString& needle, QVector<int>& rows) const {
+  if (!searchIndex_ || needle.size() < TrigramIndex::kGram) return false;
+
+  const QVector<int>& rowPos = rowPositions();
+  rows.clear();
+  for (const int rowId : searchIndex_->candidates(needle)) {
+    const int r = rowId < rowPos.size() ? rowPos[rowId] : -1;
+    if (r >= 0) rows.push_back(r); // removed rows are stale entries
+  }
+  std::sort(rows.begin(), rows.end());
+  return true;
+}
+
+CsvTableModel::Snapshot CsvTableModel::snapshot() const {
+  return {store_, headers_, rowIds_, colIds_, overlay_, revision_};
+}
+
+qint64 CsvTableModel::memoryBytes() const {
+  qint64 bytes = store_ ? store_->memoryBytes() : 0;
+  bytes += (rowIds_.size() + colIds_.size()) * qint64(sizeof(int));
+  for (const QString& text : overlay_) bytes += 48 + text.size() * qint64(sizeof(QChar)); // 48: hash node
+  if (searchIndex_) bytes += searchIndex_->memoryBytes();
+  return bytes;
+}
+
+void CsvTableModel::Snapshot::visitCells(CsvCellSink& sink) const {
+  for (const auto& h : headers) sink.text(h);
+  sink.endRecord();
+
+  const bool hasOverlay = !overlay.isEmpty();
+  const int storeRows = store ? store->rowCount() : 0;
+  const int storeCols = store ? store->columnCount() : 0;
+
+  for (const int rowId : rowIds) {
+    for (const int colId : colIds) {
+      if (hasOverlay) {
+        const auto it = overlay.constFind(cellKey(rowId, colId));
+        if (it != overlay.constEnd()) {
+          sink.text(*it);
+          continue;
+        }
+      }
+      if (rowId < storeRows && colId < storeCols) store->writeCell(rowId, colId, sink);
+      else sink.text({});
+    }
+    sink.endRecord();
+  }
+}
+
+QString CsvTableModel::Snapshot::cellText(int row, int col) const {
+  return textIn(store.get(), overlay, rowIds[row], colIds[col]);
+}
+
+bool CsvTableModel::Snapshot::cellNumber(int row, int col, double& out) const {
+  return numberIn(store.get(), overlay, rowIds[row], colIds[col], out);
+}
+
+const QStringList* CsvTableModel::Snapshot::dictionary(int col) const {
+  if (!store || col < 0 || col >= colIds.size()) return nullptr;
+  return store->dictionary(colIds[col]);
+}
+
+int CsvTableModel::Snapshot::dictionaryCode(int row, int col) const {
+  if (row < 0 || row >= rowIds.size() || col < 0 || col >= colIds.size()) return -1;
+  return codeIn(store.get(), overlay, rowIds[row], colIds[col]);
 }
 
 QVariant CsvTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
@@ -45,37 +304,97 @@ Qt::ItemFlags CsvTableModel::flags(const QModelIndex& index) const {
 
 void CsvTableModel::clear() {
   beginResetModel();
+  store_.reset();
   headers_.clear();
-  rows_.clear();
+  rowIds_.clear();
+  colIds_.clear();
+  overlay_.clear();
+  nextRowId_ = 0;
+  nextColId_ = 0;
+  ++revision_;
+  ++rowsVersion_;
+  sortCache_.clear();
+  dropSearchIndex();
   numericColsLower_.clear();
+  colTypes_.clear();
   endResetModel();
 }
 
-void CsvTableModel::setTable(const QStringList& headers, const QVector<QStringList>& rows) {
-  beginResetModel();
-  headers_ = headers;
-  rows_ = rows;
+void CsvTableModel::setTable(const QStringList& headers, QVector<QStringList> rows) {
+  setStore(ColumnarCsvStore::fromRows(headers, rows));
+}
 
-  // Ensure all rows are sized to header count
-  for (auto& r : rows_) r.resize(headers_.size());
+void CsvTableModel::setStore(std::shared_ptr<const CsvBackingStore> store) {
+  beginResetModel();
+  store_ = std::move(store);
+  headers_ = store_ ? store_->headers() : QStringList();
+  overlay_.clear();
+
+  nextRowId_ = store_ ? store_->rowCount() : 0;
+  nextColId_ = headers_.size();
+  rowIds_.resize(nextRowId_);
+  colIds_.resize(nextColId_);
+  std::iota(rowIds_.begin(), rowIds_.end(), 0);
+  std::iota(colIds_.begin(), colIds_.end(), 0);
+  resolveColumnTypes();
+  ++revision_;
+  ++rowsVersion_;
+  sortCache_.clear();
+  dropSearchIndex();
 
   endResetModel();
 }
 
+void CsvTableModel::growStore(std::shared_ptr<const CsvBackingStore> store) {
+  if (!store_ || !store || store_->headers() != store->headers()) {
+    setStore(std::move(store));
+    return;
+  }
+
+  // Leading rows are identical, so existing ids (and edits) stay valid; only the tail is new
+  const int oldRows = store_->rowCount();
+  const int newRows = store->rowCount();
+  store_ = std::move(store);
+  if (newRows <= oldRows) return;
+
+  const int first = rowIds_.size();
+  beginInsertRows(QModelIndex(), first, first + (newRows - oldRows) - 1);
+  rowIds_.reserve(rowIds_.size() + (newRows - oldRows));
+  for (int id = oldRows; id < newRows; ++id) rowIds_.push_back(id);
+  nextRowId_ = std::max(nextRowId_, newRows);
+  ++revision_;
+  ++rowsVersion_;
+  dropSearchIndex();
+  endInsertRows();
+}
+
+void CsvTableModel::dropOverlay(int rowId, int colId) {
+  for (auto it = overlay_.begin(); it != overlay_.end();) {
+    const int r = int(it.key() >> 32);
+    const int c = int(it.key() & 0xffffffffu);
+    if ((rowId < 0 || r == rowId) && (colId < 0 || c == colId)) it = overlay_.erase(it);
+    else ++it;
+  }
+}
+
 void CsvTableModel::addColumn(const QString& name) {
   const int newCol = headers_.size();
   beginInsertColumns(QModelIndex(), newCol, newCol);
   headers_.push_back(name);
-  for (auto& r : rows_) r.push_back("");
+  colIds_.push_back(nextColId_++);
+  colTypes_.push_back(resolveColumnType(name));
+  ++revision_;
   endInsertColumns();
 }
 
 void CsvTableModel::addColumn(const QString& name, bool isNumeric) {
-  addColumn(name);
-
+  // Type first, so columnsInserted listeners already see it
   const QString key = name.trimmed().toLower();
   if (isNumeric) numericColsLower_.insert(key);
   else numericColsLower_.remove(key);
+  resolveColumnTypes();
+
+  addColumn(name);
 }
 
 void CsvTableModel::deleteColumn(int col) {
@@ -86,44 +405,117 @@ void CsvTableModel::deleteColumn(int col) {
 
   beginRemoveColumns(QModelIndex(), col, col);
   headers_.removeAt(col);
-  for (auto& r : rows_) {
-    if (col >= 0 && col < r.size()) r.removeAt(col);
-  }
+  resolveColumnTypes();
+  dropOverlay(-1, colIds_[col]);
+  colIds_.removeAt(col);
+  ++revision_;
   endRemoveColumns();
 }
 
 void CsvTableModel::addRow() {
-  const int r = rows_.size();
-  beginInsertRows(QModelIndex(), r, r);
-  QStringList row;
-  row.resize(headers_.size());
-  for (int i = 0; i < row.size(); ++i) row[i] = "";
-  rows_.push_back(row);
-  endInsertRows();
+  insertRows(rowIds_.size(), 1);
 }
 
 void CsvTableModel::deleteRow(int row) {
-  if (row < 0 || row >= rows_.size()) return;
-  beginRemoveRows(QModelIndex(), row, row);
-  rows_.removeAt(row);
-  endRemoveRows();
+  removeRows(row, 1);
+}
+
+bool CsvTableModel::insertRows(int row, int count, const QModelIndex& parent) {
+  if (parent.isValid() || row < 0 || row > rowIds_.size() || count <= 0) return false;
+
+  beginInsertRows(QModelIndex(), row, row + count - 1);
+  rowIds_.insert(row, count, 0);
+  std::iota(rowIds_.begin() + row, rowIds_.begin() + row + count, nextRowId_);
+  nextRowId_ += count;
+  ++revision_;
+  ++rowsVersion_;
+  endInsertRows();
+  return true;
+}
+
+bool CsvTableModel::removeRows(int row, int count, const QModelIndex& parent) {
+  if (parent.isValid() || row < 0 || count <= 0 || row + count > rowIds_.size()) return false;
+  removeRowRuns({{row, count}});
+  return true;
+}
+
+void CsvTableModel::removeRows(QVector<int> rows) {
+  std::sort(rows.begin(), rows.end());
+  rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+  QVector<QPair<int, int>> runs;
+  for (const int r : rows) {
+    if (r < 0 || r >= rowIds_.size()) continue;
+    if (!runs.isEmpty() && runs.last().first + runs.last().second == r) ++runs.last().second;
+    else runs.push_back({r, 1});
+  }
+  if (!runs.isEmpty()) removeRowRuns(runs);
+}
+
+void CsvTableModel::removeRowRuns(const QVector<QPair<int, int>>& runs) {
+  // Edits of the removed rows go in one pass over the overlay
+  if (!overlay_.isEmpty()) {
+    QSet<int> gone;
+    for (const auto& run : runs) {
+      for (int r = run.first; r < run.first + run.second; ++r) gone.insert(rowIds_[r]);
+    }
+    for (auto it = overlay_.begin(); it != overlay_.end();) {
+      if (gone.contains(int(it.key() >> 32))) it = overlay_.erase(it);
+      else ++it;
+    }
+  }
+
+  QVector<QPair<int, int>> applied(runs.crbegin(), runs.crend());
+
+  if (runs.size() > kMaxRemoveSignals) {
+    // Scattered selection: compact the ids in one pass, one reset instead of a signal per run
+    beginResetModel();
+    qsizetype out = runs.first().first;
+    qsizetype next = 0;
+    for (qsizetype in = out; in < rowIds_.size(); ++in) {
+      if (next < runs.size() && in == runs[next].first) {
+        in += runs[next++].second - 1;
+        continue;
+      }
+      rowIds_[out++] = rowIds_[in];
+    }
+    rowIds_.resize(out);
+    ++revision_;
+    ++rowsVersion_;
+    endResetModel();
+  } else {
+    // Highest run first, so the lower runs keep their positions
+    for (const auto& run : applied) {
+      beginRemoveRows(QModelIndex(), run.first, run.first + run.second - 1);
+      rowIds_.remove(run.first, run.second);
+      ++revision_;
+      ++rowsVersion_;
+      endRemoveRows();
+    }
+  }
+
+  emit rowRunsRemoved(applied);
 }
 
 void CsvTableModel::setNumericColumns(const QSet<QString>& colsLower) {
   numericColsLower_.clear();
   for (const auto& s : colsLower) numericColsLower_.insert(s.trimmed().toLower());
+  resolveColumnTypes();
 }
 
 QSet<QString> CsvTableModel::numericColumns() const {
   return numericColsLower_;
 }
 
-bool CsvTableModel::isNumericColumn(int col) const {
-  if (col < 0 || col >= headers_.size()) return false;
+void CsvTableModel::resolveColumnTypes() {
+  colTypes_.resize(headers_.size());
+  for (int c = 0; c < headers_.size(); ++c) colTypes_[c] = resolveColumnType(headers_[c]);
+}
 
+CsvTableModel::ColumnType CsvTableModel::resolveColumnType(const QString& header) const {
   // 1) Explicit schema wins
-  const QString key = headers_[col].trimmed().toLower();
-  if (numericColsLower_.contains(key)) return true;
+  const QString key = header.trimmed().toLower();
+  if (numericColsLower_.contains(key)) return ColumnType::Numeric;
 
   // 2) Fallback heuristic (for older CSVs without schema)
   QString h = key;
@@ -143,26 +535,15 @@ bool CsvTableModel::isNumericColumn(int col) const {
     "price", "cost"
   };
 
-  if (keys.contains(h) || keys.contains(simplified)) return true;
-  if (simplified.endsWith("ton") || simplified.endsWith("tons")) return true;
+  if (keys.contains(h) || keys.contains(simplified)) return ColumnType::Numeric;
+  if (simplified.endsWith("ton") || simplified.endsWith("tons")) return ColumnType::Numeric;
 
-  return false;
+  return ColumnType::Text;
 }
 
-bool CsvTableModel::parseNumber(QString s, double& out) {
-  s = s.trimmed();
-  if (s.isEmpty()) return false;
-
-  // accept decimal comma, normalize to dot
-  s.replace(',', '.');
-
-  // Allow: -12, 12, 12.5, 12., .5
-  static const QRegularExpression re(R"(^[+-]?(\d+(\.\d*)?|\.\d+)$)");
-  if (!re.match(s).hasMatch()) return false;
-
-  bool ok = false;
-  out = s.toDouble(&ok);
-  return ok;
+bool CsvTableModel::parseNumber(QStringView s, double& out) {
+  // Allow: -12, 12, 12.5, 12., .5 and the same with a decimal comma
+  return NumberParser::parse(s, out);
 }
 
 bool CsvTableModel::setData(const QModelIndex& index, const QVariant& value, int role) {
@@ -171,7 +552,7 @@ bool CsvTableModel::setData(const QModelIndex& index, const QVariant& value, int
 
   const int r = index.row();
   const int c = index.column();
-  if (r < 0 || r >= rows_.size()) return false;
+  if (r < 0 || r >= rowIds_.size()) return false;
   if (c < 0 || c >= headers_.size()) return false;
 
   QString text = value.toString();
@@ -193,12 +574,15 @@ bool CsvTableModel::setData(const QModelIndex& index, const QVariant& value, int
     }
   }
 
-  // Ensure row size matches headers
-  if (rows_[r].size() != headers_.size()) rows_[r].resize(headers_.size());
+  if (cellText(r, c) == text) return true;
 
-  if (rows_[r][c] == text) return true;
+  overlay_.insert(cellKey(rowIds_[r], colIds_[c]), text);
+  ++revision_;
+  ++colVersions_[colIds_[c]];
 
-  rows_[r][c] = text;
+  // The old text's trigrams stay behind as stale entries; searches verify every candidate
+  if (searchIndex_) searchIndex_->add(rowIds_[r], text);
+  else if (searchIndexBuilding_) unindexedRows_.insert(rowIds_[r]);
   emit dataChanged(index, index, {Qt::DisplayRole, Qt::EditRole});
   return true;
 }
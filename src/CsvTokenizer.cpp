@@ -0,0 +1,428 @@
+#include "CsvTokenizer.hpp"
+
+#include <QtAlgorithms>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QByteArray>
+#include <QThread>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CSV_TOKENIZER_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CSV_TOKENIZER_SSE2 1
+#endif
+
+namespace {
+
+constexpr qint64 kBlock = 64;
+
+// One bit per byte of a 64-byte block
+struct BlockMasks {
+  quint64 quote = 0;
+  quint64 comma = 0;
+  quint64 newline = 0;
+  quint64 cr = 0;
+};
+
+#if defined(CSV_TOKENIZER_AVX2)
+
+inline quint64 eqMask(__m256i lo, __m256i hi, char c) {
+  const __m256i needle = _mm256_set1_epi8(c);
+  const quint64 a = static_cast<quint32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle)));
+  const quint64 b = static_cast<quint32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle)));
+  return a | (b << 32);
+}
+
+inline BlockMasks classify(const char* p) {
+  const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+  return { eqMask(lo, hi, '"'), eqMask(lo, hi, ','), eqMask(lo, hi, '\n'), eqMask(lo, hi, '\r') };
+}
+
+#elif defined(CSV_TOKENIZER_SSE2)
+
+inline quint64 eqMask(const __m128i (&v)[4], char c) {
+  const __m128i needle = _mm_set1_epi8(c);
+  quint64 m = 0;
+  for (int i = 0; i < 4; ++i) {
+    const quint64 bits = static_cast<quint16>(_mm_movemask_epi8(_mm_cmpeq_epi8(v[i], needle)));
+    m |= bits << (16 * i);
+  }
+  return m;
+}
+
+inline BlockMasks classify(const char* p) {
+  const __m128i v[4] = {
+    _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)),
+    _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16)),
+    _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32)),
+    _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 48))
+  };
+  return { eqMask(v, '"'), eqMask(v, ','), eqMask(v, '\n'), eqMask(v, '\r') };
+}
+
+#else
+
+inline BlockMasks classify(const char* p) {
+  BlockMasks m;
+  for (int i = 0; i < kBlock; ++i) {
+    const quint64 bit = quint64(1) << i;
+    switch (p[i]) {
+      case '"':  m.quote |= bit; break;
+      case ',':  m.comma |= bit; break;
+      case '\n': m.newline |= bit; break;
+      case '\r': m.cr |= bit; break;
+      default: break;
+    }
+  }
+  return m;
+}
+
+#endif
+
+// Bit i = parity of quote bits 0..i, i.e. "inside quotes" after byte i
+inline quint64 prefixXor(quint64 x) {
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+}
+
+inline bool isBlankByte(char ch) {
+  return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\v' || ch == '\f';
+}
+
+bool isBlank(const char* data, qint64 begin, qint64 end) {
+  for (qint64 i = begin; i < end; ++i) {
+    if (!isBlankByte(data[i])) return false;
+  }
+  return true;
+}
+
+qint64 contentStart(const char* data, qint64 size) {
+  if (size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0) return 3; // UTF-8 BOM
+  return 0;
+}
+
+// Walks [start, size) 64 bytes at a time and hands every block's masks plus its
+// in-quote mask to onBlock(base, masks, inside). Returns true if the data ends inside quotes.
+template <typename OnBlock>
+bool scanBlocks(const char* data, qint64 start, qint64 size, bool startInside, OnBlock&& onBlock) {
+  quint64 insideCarry = startInside ? ~quint64(0) : 0; // all ones when the block starts inside quotes
+
+  for (qint64 base = start; base < size; base += kBlock) {
+    const qint64 n = std::min(kBlock, size - base);
+    BlockMasks m;
+    if (n == kBlock) {
+      m = classify(data + base);
+    } else {
+      char tail[kBlock] = {};
+      std::memcpy(tail, data + base, static_cast<size_t>(n));
+      m = classify(tail);
+    }
+
+    const quint64 inside = prefixXor(m.quote) ^ insideCarry;
+    insideCarry = quint64(0) - (inside >> 63);
+    onBlock(base, m, inside);
+  }
+  return insideCarry != 0;
+}
+
+// An unterminated quote runs to EOF, minus the final line break (readLine never returned it)
+qint64 unterminatedEnd(const char* data, qint64 begin, qint64 end) {
+  while (end > begin && data[end - 1] == '\r') --end;
+  if (end > begin && data[end - 1] == '\n') --end;
+  return end;
+}
+
+// Structural events (unquoted commas / newlines) of one byte range, scanned from a given quote state
+struct ChunkScan {
+  qint64 begin = 0;
+  qint64 end = 0;
+  bool startInside = false;
+  bool endInside = false;
+  bool tailSpecial = false;   // quote/CR after the last event
+  QVector<quint64> events;    // byte position | kNewlineEvent | kSpecialEvent
+};
+
+constexpr quint64 kNewlineEvent = quint64(1) << 63;
+constexpr quint64 kSpecialEvent = quint64(1) << 62; // quote/CR since the previous event
+constexpr quint64 kPositionMask = kSpecialEvent - 1;
+
+constexpr qint64 kParallelMinBytes = 4 * 1024 * 1024;
+constexpr qint64 kMinChunkBytes = 1024 * 1024;
+
+void scanChunk(const char* data, ChunkScan& chunk) {
+  chunk.events.clear();
+  chunk.events.reserve(static_cast<qsizetype>((chunk.end - chunk.begin) / 8));
+
+  qint64 segmentStart = chunk.begin;
+  qint64 lastSpecial = -1; // last quote/CR before the current block
+
+  chunk.endInside = scanBlocks(data, chunk.begin, chunk.end, chunk.startInside,
+                               [&](qint64 base, const BlockMasks& m, quint64 inside) {
+    const quint64 special = m.quote | m.cr;
+
+    // Any quote/CR in [begin, end)? Decided from the masks, no rescan of the bytes.
+    auto hasSpecial = [&](qint64 begin, qint64 end) {
+      if (end <= begin) return false;
+      if (end <= base) return true; // CR trimmed right at a block edge: take the slow path
+      const qint64 hi = end - base;
+      quint64 bits = hi >= kBlock ? special : special & ((quint64(1) << hi) - 1);
+      if (begin > base) bits &= ~((quint64(1) << (begin - base)) - 1);
+      if (bits) return true;
+      return begin < base && lastSpecial >= begin;
+    };
+
+    quint64 structural = (m.comma | m.newline) & ~inside;
+    while (structural) {
+      const int bit = qCountTrailingZeroBits(structural);
+      structural &= structural - 1;
+
+      const qint64 at = base + bit;
+      const bool newline = (m.newline >> bit) & 1;
+
+      qint64 end = at;
+      if (newline && end > segmentStart && data[end - 1] == '\r') --end;
+
+      quint64 event = quint64(at);
+      if (newline) event |= kNewlineEvent;
+      if (hasSpecial(segmentStart, end)) event |= kSpecialEvent;
+      chunk.events.push_back(event);
+      segmentStart = at + 1;
+    }
+
+    if (special) lastSpecial = base + 63 - qCountLeadingZeroBits(special);
+  });
+
+  chunk.tailSpecial = lastSpecial >= segmentStart;
+}
+
+// Speculative pass: every chunk assumes it starts outside quotes. The real start state is
+// the parity of all quotes before it, so only chunks that guessed wrong are scanned again.
+QVector<ChunkScan> scanChunks(const char* data, qint64 start, qint64 size) {
+  const qint64 bytes = size - start;
+  const int threads = QThread::idealThreadCount();
+  qint64 count = 1;
+  if (bytes >= kParallelMinBytes && threads > 1) count = std::min<qint64>(threads * 4, bytes / kMinChunkBytes);
+
+  const qint64 step = std::max<qint64>(1, (bytes + count - 1) / count);
+  count = std::max<qint64>(1, (bytes + step - 1) / step);
+
+  QVector<ChunkScan> chunks(static_cast<qsizetype>(count));
+  for (qsizetype i = 0; i < chunks.size(); ++i) {
+    chunks[i].begin = start + i * step;
+    chunks[i].end = std::min(size, chunks[i].begin + step);
+  }
+
+  if (chunks.size() == 1) {
+    scanChunk(data, chunks.first());
+    return chunks;
+  }
+
+  QtConcurrent::blockingMap(chunks, [data](ChunkScan& c) { scanChunk(data, c); });
+
+  bool inside = false;
+  bool fixup = false;
+  for (auto& c : chunks) {
+    const bool parity = c.endInside; // scanned from "outside", so this is the chunk's own quote parity
+    c.startInside = inside;
+    fixup = fixup || inside;
+    inside = inside != parity;
+  }
+
+  if (fixup) {
+    QtConcurrent::blockingMap(chunks, [data](ChunkScan& c) {
+      if (c.startInside) scanChunk(data, c);
+    });
+  }
+  return chunks;
+}
+
+} // namespace
+
+namespace CsvTokenizer {
+
+Index tokenize(const char* data, qint64 size) {
+  Index idx;
+  if (!data || size <= 0) return idx;
+
+  const qint64 start = contentStart(data, size);
+  const QVector<ChunkScan> chunks = scanChunks(data, start, size);
+
+  qsizetype events = 1;
+  for (const auto& c : chunks) events += c.events.size();
+  idx.fields.reserve(events);
+
+  // Stitch the chunks' events back into fields and records, in order
+  qint64 fieldStart = start;
+  qint64 recordStart = start;
+  bool pendingSpecial = false; // quote/CR in the part of the current field seen so far
+
+  auto pushField = [&](qint64 begin, qint64 end, bool plain) {
+    Field f;
+    f.begin = begin;
+    f.size = static_cast<qint32>(end - begin);
+    f.plain = plain;
+    idx.fields.push_back(f);
+  };
+
+  auto closeRecord = [&](qint64 end) {
+    const qsizetype first = idx.recordStart.last();
+    if (idx.fields.size() - first == 1 && isBlank(data, recordStart, end)) {
+      idx.fields.removeLast();
+      return;
+    }
+    idx.recordStart.push_back(idx.fields.size());
+  };
+
+  for (const auto& chunk : chunks) {
+    for (const quint64 event : chunk.events) {
+      const qint64 at = qint64(event & kPositionMask);
+      const bool newline = event & kNewlineEvent;
+
+      qint64 end = at;
+      if (newline && end > fieldStart && data[end - 1] == '\r') --end;
+      pushField(fieldStart, end, !pendingSpecial && !(event & kSpecialEvent));
+      fieldStart = at + 1;
+      pendingSpecial = false;
+
+      if (newline) {
+        closeRecord(at);
+        recordStart = at + 1;
+      }
+    }
+    pendingSpecial = pendingSpecial || chunk.tailSpecial;
+  }
+
+  // Last record without a trailing newline
+  if (recordStart < size) {
+    const qint64 end = chunks.last().endInside ? unterminatedEnd(data, fieldStart, size) : size;
+    pushField(fieldStart, end, !pendingSpecial);
+    closeRecord(end);
+  }
+
+  return idx;
+}
+
+QVector<Record> indexRecords(const char* data, qint64 size) {
+  QVector<Record> records;
+  if (!data || size <= 0) return records;
+
+  const qint64 start = contentStart(data, size);
+  qint64 recordStart = start;
+
+  auto closeRecord = [&](qint64 end) {
+    if (!isBlank(data, recordStart, end)) records.push_back({recordStart, end});
+  };
+
+  const bool openQuote = scanBlocks(data, start, size, false, [&](qint64 base, const BlockMasks& m, quint64 inside) {
+    quint64 newlines = m.newline & ~inside;
+    while (newlines) {
+      const qint64 at = base + qCountTrailingZeroBits(newlines);
+      newlines &= newlines - 1;
+
+      qint64 end = at;
+      if (end > recordStart && data[end - 1] == '\r') --end;
+      closeRecord(end);
+      recordStart = at + 1;
+    }
+  });
+
+  if (recordStart < size) closeRecord(openQuote ? unterminatedEnd(data, recordStart, size) : size);
+  return records;
+}
+
+bool findField(const char* data, const Record& rec, int col, Field& out) {
+  int current = 0;
+  qint64 fieldStart = rec.begin;
+  bool inQuotes = false;
+  bool plain = true;
+
+  auto take = [&](qint64 end) {
+    out.begin = fieldStart;
+    out.size = static_cast<qint32>(end - fieldStart);
+    out.plain = plain;
+    return true;
+  };
+
+  for (qint64 i = rec.begin; i < rec.end; ++i) {
+    const char ch = data[i];
+    if (ch == '"') {
+      inQuotes = !inQuotes;
+      plain = false;
+    } else if (ch == '\r') {
+      plain = false;
+    } else if (ch == ',' && !inQuotes) {
+      if (current == col) return take(i);
+      ++current;
+      fieldStart = i + 1;
+      plain = true;
+    }
+  }
+  return current == col && take(rec.end);
+}
+
+QStringList splitRecord(const char* data, const Record& rec) {
+  QStringList fields;
+  Field f;
+  for (int col = 0; findField(data, rec, col, f); ++col) fields.push_back(decodeField(data, f));
+  return fields;
+}
+
+void appendFieldUtf8(QByteArray& out, const char* data, const Field& f) {
+  const char* p = data + f.begin;
+  if (f.plain) {
+    out.append(p, f.size);
+    return;
+  }
+
+  // Quoted / escaped field: same rules as parseCsvRecord; CR never survives a text-mode read
+  bool inQuotes = false;
+  for (qint32 i = 0; i < f.size; ++i) {
+    const char ch = p[i];
+    if (ch == '\r') continue;
+    if (ch != '"') {
+      out += ch;
+    } else if (!inQuotes) {
+      inQuotes = true;
+    } else {
+      qint32 next = i + 1;
+      while (next < f.size && p[next] == '\r') ++next;
+      if (next < f.size && p[next] == '"') {
+        out += '"';
+        i = next;
+      } else {
+        inQuotes = false;
+      }
+    }
+  }
+}
+
+QString decodeField(const char* data, const Field& f) {
+  if (f.plain) return QString::fromUtf8(data + f.begin, f.size);
+
+  QByteArray out;
+  out.reserve(f.size);
+  appendFieldUtf8(out, data, f);
+  return QString::fromUtf8(out);
+}
+
+QStringList decodeRecord(const char* data, const Index& idx, qsizetype record) {
+  const qsizetype first = idx.recordStart[record];
+  const qsizetype last = idx.recordStart[record + 1];
+
+  QStringList fields;
+  fields.reserve(last - first);
+  for (qsizetype i = first; i < last; ++i) fields.push_back(decodeField(data, idx.fields[i]));
+  return fields;
+}
+
+} // namespace CsvTokenizer
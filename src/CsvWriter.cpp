@@ -0,0 +1,98 @@
+#include "CsvWriter.hpp"
+
+#include <QIODevice>
+
+#include <cstring>
+
+CsvWriter::CsvWriter(QIODevice* device, qsizetype blockSize) : device_(device) {
+  buffer_.resize(blockSize);
+}
+
+char* CsvWriter::reserve(qsizetype bytes) {
+  if (buffer_.size() - used_ < bytes) {
+    flush();
+    if (buffer_.size() < bytes) buffer_.resize(bytes);
+  }
+  return buffer_.data() + used_;
+}
+
+void CsvWriter::separator() {
+  if (firstField_) {
+    firstField_ = false;
+    return;
+  }
+  *reserve(1) = ',';
+  ++used_;
+}
+
+void CsvWriter::text(QStringView field) {
+  separator();
+
+  bool mustQuote = false;
+  qsizetype quotes = 0;
+  for (const QChar ch : field) {
+    switch (ch.unicode()) {
+      case '"': ++quotes; mustQuote = true; break;
+      case ',': case '\n': case '\r': mustQuote = true; break;
+      default: break;
+    }
+  }
+
+  // UTF-8 needs at most 3 bytes per UTF-16 unit; plus doubled quotes and the surrounding pair
+  char* out = reserve(field.size() * 3 + quotes + 2);
+  if (mustQuote) *out++ = '"';
+  qsizetype from = 0;
+  for (qsizetype i = 0; quotes && i < field.size(); ++i) {
+    if (field[i] != u'"') continue;
+    out = encoder_.appendToBuffer(out, field.sliced(from, i + 1 - from));
+    *out++ = '"';
+    from = i + 1;
+  }
+  out = encoder_.appendToBuffer(out, field.sliced(from));
+  if (mustQuote) *out++ = '"';
+  used_ = out - buffer_.data();
+}
+
+void CsvWriter::utf8(QByteArrayView field) {
+  separator();
+
+  bool mustQuote = false;
+  qsizetype quotes = 0;
+  for (const char ch : field) {
+    switch (ch) {
+      case '"': ++quotes; mustQuote = true; break;
+      case ',': case '\n': case '\r': mustQuote = true; break;
+      default: break;
+    }
+  }
+
+  char* out = reserve(field.size() + quotes + 2);
+  if (mustQuote) *out++ = '"';
+  const char* p = field.data();
+  const qsizetype n = field.size();
+  if (!quotes) {
+    if (n) std::memcpy(out, p, size_t(n));
+    out += n;
+  } else {
+    for (qsizetype i = 0; i < n; ++i) {
+      *out++ = p[i];
+      if (p[i] == '"') *out++ = '"';
+    }
+  }
+  if (mustQuote) *out++ = '"';
+  used_ = out - buffer_.data();
+}
+
+void CsvWriter::endRecord() {
+  *reserve(1) = '\n';
+  ++used_;
+  firstField_ = true;
+}
+
+bool CsvWriter::flush() {
+  if (used_ > 0 && ok_) {
+    if (device_->write(buffer_.constData(), used_) != used_) ok_ = false;
+  }
+  used_ = 0;
+  return ok_;
+}
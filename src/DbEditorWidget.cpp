@@ -1,10 +1,19 @@
 #include "DbEditorWidget.hpp"
 
 #include "CsvTableModel.hpp"
-#include "CsvUtils.hpp"
+#include "CsvWriter.hpp"
+#include "CsvLoadJob.hpp"
+#include "CsvCache.hpp"
+#include "EditJournal.hpp"
+#include "RowFilterJob.hpp"
 #include "BackupUtils.hpp"
+#include "BackupStore.hpp"
+#include "BackupBrowserDialog.hpp"
 #include "AdminDbPaths.hpp"
+#include "TableSchema.hpp"
+#include "TableStorage.hpp"
 
+#include <QCheckBox>
 #include <QComboBox>
 #include <QTableView>
 #include <QVBoxLayout>
@@ -13,73 +22,373 @@
 #include <QHeaderView>
 #include <QInputDialog>
 #include <QLineEdit>
+#include <QProgressBar>
+#include <QScrollBar>
 #include <QMessageBox>
-#include <QFile>
-#include <QTextStream>
-#include <QStringConverter>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QSaveFile>
 #include <QSortFilterProxyModel>
-#include <QRegularExpression>
 #include <QAbstractItemView>
 #include <QItemSelectionModel>
-
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonArray>
+#include <QBitArray>
+#include <QTimer>
+#include <QFutureWatcher>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
 
 #include <algorithm>
-#include <vector>
 
-// ---- Proxy model: filter rows if ANY cell contains the search text
+// ---- Proxy model: filter rows if ANY cell contains the search text, or by a column query (RowQuery).
+// Rows are matched on the thread pool (RowFilterJob); the proxy only looks up the published result.
 class RowFilterProxy : public QSortFilterProxyModel {
 public:
-  using QSortFilterProxyModel::QSortFilterProxyModel;
+  explicit RowFilterProxy(QObject* parent = nullptr) : QSortFilterProxyModel(parent) {
+    // Content changes run the search again; a burst of them (paste, load batches) runs it once
+    refilter_ = new QTimer(this);
+    refilter_->setSingleShot(true);
+    refilter_->setInterval(0);
+    connect(refilter_, &QTimer::timeout, this, [this] { startFilter(); });
+  }
+
+  ~RowFilterProxy() override {
+    if (job_) job_->cancel();
+  }
+
+  void setSourceModel(QAbstractItemModel* model) override {
+    for (const auto& c : std::as_const(sourceConnections_)) disconnect(c);
+    sourceConnections_.clear();
+    QSortFilterProxyModel::setSourceModel(model);
+    if (!model) return;
+
+    // The published rows are kept aligned with the source until the new result arrives;
+    // rows inserted meanwhile stay hidden
+    sourceConnections_ << connect(model, &QAbstractItemModel::rowsAboutToBeInserted, this,
+                                  [this](const QModelIndex&, int first, int last) {
+                                    accepted_ = spliced(accepted_, first, 0, last - first + 1);
+                                    if (!scores_.isEmpty() && first <= scores_.size()) scores_.insert(first, last - first + 1, 0);
+                                  });
+    sourceConnections_ << connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this,
+                                  [this](const QModelIndex&, int first, int last) {
+                                    accepted_ = spliced(accepted_, first, last - first + 1, 0);
+                                    if (last < scores_.size()) scores_.remove(first, last - first + 1);
+                                  });
+    sourceConnections_ << connect(model, &QAbstractItemModel::modelAboutToBeReset, this, [this] {
+      accepted_.clear();
+      scores_.fill(0, 0);
+    });
+
+    const auto changed = [this] { contentChanged(); };
+    sourceConnections_ << connect(model, &QAbstractItemModel::dataChanged, this, changed);
+    sourceConnections_ << connect(model, &QAbstractItemModel::rowsInserted, this, changed);
+    sourceConnections_ << connect(model, &QAbstractItemModel::rowsRemoved, this, changed);
+    sourceConnections_ << connect(model, &QAbstractItemModel::columnsInserted, this, changed);
+    sourceConnections_ << connect(model, &QAbstractItemModel::columnsRemoved, this, changed);
+    sourceConnections_ << connect(model, &QAbstractItemModel::headerDataChanged, this, changed);
+    sourceConnections_ << connect(model, &QAbstractItemModel::modelReset, this, changed);
+  }
+
+  // Literal, case-insensitive search or a column query. Returns at once: the view keeps
+  // showing the previous result until the new one is published.
+  void setSearchText(const QString& text) {
+    if (text == needle_) return;
+    needle_ = text;
+    startFilter();
+  }
+
+  // Text terms tolerate typos; while no column is sorted, the best matches come first
+  void setFuzzy(bool on) {
+    if (on == fuzzy_) return;
+    fuzzy_ = on;
+    startFilter();
+  }
+
+  int userSortColumn() const { return userSortColumn_; }
+
+  void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override {
+    userSortColumn_ = column;
+    if (column < 0 && !scores_.isEmpty()) QSortFilterProxyModel::sort(0, Qt::AscendingOrder); // ranked
+    else QSortFilterProxyModel::sort(column, order);
+  }
 
 protected:
   bool filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const override {
-    if (filterRegularExpression().pattern().isEmpty()) return true;
+    if (!filtering_) return true;
+
+    const auto* csv = qobject_cast<const CsvTableModel*>(sourceModel());
+    if (!csv) {
+      const int cols = sourceModel() ? sourceModel()->columnCount(sourceParent) : 0;
+      for (int c = 0; c < cols; ++c) {
+        const QModelIndex idx = sourceModel()->index(sourceRow, c, sourceParent);
+        if (sourceModel()->data(idx, Qt::DisplayRole).toString().contains(needle_, Qt::CaseInsensitive)) return true;
+      }
+      return false;
+    }
+    return sourceRow < accepted_.size() && accepted_.testBit(sourceRow);
+  }
 
-    const int cols = sourceModel() ? sourceModel()->columnCount(sourceParent) : 0;
-    for (int c = 0; c < cols; ++c) {
-      const QModelIndex idx = sourceModel()->index(sourceRow, c, sourceParent);
-      const QString text = sourceModel()->data(idx, Qt::DisplayRole).toString();
-      if (text.contains(filterRegularExpression())) return true;
+  // Rows are ordered by the model's precomputed ranks: one int compare per comparison
+  bool lessThan(const QModelIndex& left, const QModelIndex& right) const override {
+    if (userSortColumn_ < 0 && !scores_.isEmpty()) {
+      // Fuzzy ranking: fewer typos first, file order among equals
+      const int l = left.row();
+      const int r = right.row();
+      if (l >= scores_.size() || r >= scores_.size()) return l < r;
+      return scores_[l] != scores_[r] ? scores_[l] < scores_[r] : l < r;
     }
-    return false;
+
+    const auto* csv = qobject_cast<const CsvTableModel*>(sourceModel());
+    if (!csv) return QSortFilterProxyModel::lessThan(left, right);
+
+    if (csv->revision() != rankRevision_ || left.column() != rankColumn_) {
+      ranks_ = csv->sortRanks(left.column());
+      rankRevision_ = csv->revision();
+      rankColumn_ = left.column();
+    }
+    const int l = left.row();
+    const int r = right.row();
+    if (l >= ranks_.size() || r >= ranks_.size()) return l < r;
+    return ranks_[l] < ranks_[r];
+  }
+
+private:
+  // A finished filter pass: which source rows matched `folded` at model `revision`
+  struct FilterResult {
+    QString folded;
+    quint64 revision = 0;
+    QBitArray accepted;
+    QVector<quint8> scores; // fuzzy passes: typos per row
+    bool plain = true;      // substring search, not a column query
+    bool fuzzy = false;
+  };
+  static constexpr int kMaxFilterResults = 32;
+
+  // Copy of `bits` with `removeCount` bits at `at` replaced by `insertCount` clear ones
+  static QBitArray spliced(const QBitArray& bits, int at, int removeCount, int insertCount) {
+    if (bits.isEmpty()) return bits;
+    QBitArray out(bits.size() - removeCount + insertCount);
+    for (int i = 0; i < at && i < bits.size(); ++i) out.setBit(i, bits.testBit(i));
+    for (int i = at + removeCount; i < bits.size(); ++i) out.setBit(i - removeCount + insertCount, bits.testBit(i));
+    return out;
+  }
+
+  void contentChanged() {
+    if (!filtering_ && needle_.isEmpty()) return;
+    if (job_) job_->cancel(); // its snapshot is already out of date
+    job_.reset();
+    refilter_->start();
+  }
+
+  void publish(QBitArray accepted, QVector<quint8> scores, bool filtering) {
+    const bool wasRanked = !scores_.isEmpty();
+    accepted_ = std::move(accepted);
+    scores_ = std::move(scores);
+    filtering_ = filtering;
+    if (userSortColumn_ >= 0 || (!wasRanked && scores_.isEmpty())) {
+      invalidateRowsFilter();
+      return;
+    }
+
+    // No column sorted: rank by score, or back to file order once the ranking is gone
+    if (scores_.isEmpty()) QSortFilterProxyModel::sort(-1);
+    else if (sortColumn() != 0) QSortFilterProxyModel::sort(0, Qt::AscendingOrder);
+    invalidate();
+  }
+
+  void startFilter() {
+    if (job_) job_->cancel();
+    job_.reset();
+
+    const auto* csv = qobject_cast<const CsvTableModel*>(sourceModel());
+    if (!csv) {
+      publish({}, {}, !needle_.isEmpty());
+      return;
+    }
+
+    const RowQuery query = RowQuery::parse(needle_, *csv, fuzzy_);
+    if (query.isEmpty()) {
+      if (filtering_ || !scores_.isEmpty()) publish({}, {}, false);
+      return;
+    }
+
+    const quint64 revision = csv->revision();
+    results_.removeIf([revision](const FilterResult& r) { return r.revision != revision; });
+
+    // Same text again (backspace): reuse it. Longer text: only rows the longest contained text kept
+    // (a longer column query is not necessarily narrower: MinTon>=8 vs MinTon>=80; nor is a fuzzy one).
+    // Plain passes are keyed by the substring they looked for, without enclosing quotes.
+    const bool plain = query.isPlainText();
+    const bool fuzzy = query.isFuzzy();
+    const QString folded = (plain ? query.plainText() : needle_).toCaseFolded();
+    int base = -1;
+    for (int i = 0; i < results_.size(); ++i) {
+      if (results_[i].folded == folded && results_[i].plain == plain && results_[i].fuzzy == fuzzy) {
+        publish(results_[i].accepted, results_[i].scores, true);
+        return;
+      }
+      if (plain && !fuzzy && results_[i].plain && !results_[i].fuzzy && folded.contains(results_[i].folded) &&
+          (base < 0 || results_[i].folded.size() > results_[base].folded.size())) base = i;
+    }
+    QBitArray mask = base >= 0 ? results_[base].accepted : QBitArray();
+
+    // Rows without every trigram of the search text cannot match; the rest are verified by the job
+    QVector<int> rows;
+    if (query.candidates(*csv, rows)) {
+      QBitArray candidates(csv->rowCount());
+      for (const int r : std::as_const(rows)) candidates.setBit(r);
+      mask = mask.isEmpty() ? candidates : (mask & candidates);
+    }
+
+    job_ = RowFilterJob::start(csv->snapshot(), query, mask, this,
+                               [this, folded, revision, plain, fuzzy](const QBitArray& accepted,
+                                                                       const QVector<quint8>& scores) {
+      job_.reset();
+      const auto* model = qobject_cast<const CsvTableModel*>(sourceModel());
+      if (!model || model->revision() != revision) return; // a newer pass is on its way
+
+      results_.removeIf([&](const FilterResult& r) { return r.folded == folded && r.plain == plain && r.fuzzy == fuzzy; });
+      results_.push_back({folded, revision, accepted, scores, plain, fuzzy});
+      if (results_.size() > kMaxFilterResults) results_.removeFirst();
+      publish(accepted, scores, true);
+    });
   }
+
+  QString needle_;
+  bool fuzzy_ = false;
+  std::shared_ptr<RowFilterJob> job_; // pass in flight, cancelled when the text or the content changes
+  QTimer* refilter_ = nullptr;
+  QList<QMetaObject::Connection> sourceConnections_;
+
+  bool filtering_ = false;
+  QBitArray accepted_;             // source rows the last published pass kept
+  QVector<quint8> scores_;         // and their typo counts, fuzzy passes only
+  int userSortColumn_ = -1;        // column sorted from the header, -1 = none
+  QVector<FilterResult> results_;  // earlier passes, oldest first
+
+  mutable QVector<int> ranks_; // source row -> position in the sorted column
+  mutable quint64 rankRevision_ = 0;
+  mutable int rankColumn_ = -1;
 };
 
-// ---- Schema helpers: store numeric columns per CSV in a sidecar JSON
-static QString schemaPathFor(const QString& csvPath) {
-  return csvPath + ".schema.json";
+// ---- Schema helpers: numeric columns and column rules per CSV in a sidecar JSON (TableSchema)
+static void loadSchemaIntoModel(const QString& csvPath, CsvTableModel* model) {
+  model->setNumericColumns(TableSchema::load(csvPath).numericColumns());
 }
 
-static void loadSchemaIntoModel(const QString& csvPath, CsvTableModel* model) {
-  model->setNumericColumns({});
+static void saveSchemaFromModel(const QString& csvPath, const CsvTableModel* model) {
+  // Only the numeric list changes; hand-written column rules are kept
+  TableSchema schema = TableSchema::load(csvPath);
+  schema.setNumericColumns(model->numericColumns());
+  schema.save(csvPath);
+}
 
-  QFile f(schemaPathFor(csvPath));
-  if (!f.open(QIODevice::ReadOnly)) return;
+// Lists the cells that break the schema's rules, one line each in the details. Rows are looked
+// up by id in `model` as it is now (rows added or removed during the check), else taken from the
+// checked snapshot; each is named by its number and first cell, which a sorted view still shows.
+static void reportSchemaIssues(QWidget* parent, const QString& path, const CsvTableModel::Snapshot& snap,
+                               const CsvTableModel* model, const QVector<TableSchema::Issue>& issues) {
+  QStringList lines;
+  lines.reserve(issues.size());
+  for (const auto& i : issues) {
+    const int row = model ? model->rowOfId(i.rowId) : i.row;
+    if (row < 0) continue; // removed since
+    const QString key = model ? model->cellText(row, 0) : snap.cellText(row, 0);
+    lines << QString("Row %1 (%2), %3: %4").arg(row + 1).arg(key.trimmed(), snap.headers.value(i.col), i.reason);
+  }
+  if (lines.isEmpty()) return;
+
+  QMessageBox box(QMessageBox::Warning, "Schema check",
+                  QString("%1: %2 cell(s) break the column rules in %3.\n"
+                          "At most %4 are listed per column.")
+                      .arg(QFileInfo(path).fileName())
+                      .arg(lines.size())
+                      .arg(TableSchema::pathFor(QFileInfo(path).fileName()))
+                      .arg(TableSchema::kMaxIssuesPerColumn),
+                  QMessageBox::Ok, parent);
+  box.setDetailedText(lines.join('\n'));
+  box.exec();
+}
 
-  const QJsonDocument doc = QJsonDocument::fromJson(f.readAll());
-  if (!doc.isObject()) return;
+// Search runs this long after the last keystroke
+static constexpr int kSearchDebounceMs = 150;
 
-  const QJsonArray arr = doc.object().value("numeric").toArray();
-  QSet<QString> set;
-  for (const auto& v : arr) set.insert(v.toString().trimmed().toLower());
-  model->setNumericColumns(set);
+// The journal is compacted into the CSV once it outgrows this (or an eighth of the CSV)
+static constexpr qint64 kCompactJournalBytes = 1024 * 1024;
+
+// ---- Saving: a model snapshot is written off the GUI thread
+struct SaveResult {
+  QString backupError;
+  QString writeError;
+};
+
+static SaveResult writeSnapshot(const QString& path, const CsvTableModel::Snapshot& snap, qint64 journalMark = -1) {
+  SaveResult r;
+  TableStorage& storage = TableStorage::instance();
+
+  // Backup CSV (keep last 10); the paged file has its write-ahead log instead
+  if (storage.usesCsvFiles()) BackupUtils::makeTimestampedBackupKeepN(path, 10, &r.backupError);
+
+  storage.save(path, snap, &r.writeError, journalMark);
+  return r;
 }
 
-static void saveSchemaFromModel(const QString& csvPath, const CsvTableModel* model) {
-  QJsonArray arr;
-  for (const auto& s : model->numericColumns()) arr.append(s);
+// Folds a database's committed journal into its CSV without a view: worker thread, private model
+static SaveResult foldJournal(const QString& path) {
+  SaveResult r;
+  QString error;
+  auto store = TableStorage::instance().load(path, &error);
+  if (!store && !error.isEmpty()) {
+    r.writeError = "Cannot open: " + path + "\n" + error;
+    return r;
+  }
+
+  CsvTableModel model;
+  loadSchemaIntoModel(path, &model);
+  if (store) model.setStore(std::move(store));
+  EditJournal::apply(model, EditJournal::readCommitted(path));
 
-  QJsonObject obj;
-  obj["numeric"] = arr;
+  saveSchemaFromModel(path, &model);
+  return writeSnapshot(path, model.snapshot(), EditJournal::committedSize(path));
+}
 
-  QFile f(schemaPathFor(csvPath));
-  if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) return;
-  f.write(QJsonDocument(obj).toJson(QJsonDocument::Indented));
+static bool reportSaveResult(QWidget* parent, const SaveResult& r) {
+  if (!r.backupError.isEmpty()) QMessageBox::warning(parent, "Backup failed", r.backupError);
+  if (!r.writeError.isEmpty()) {
+    QMessageBox::critical(parent, "Error", r.writeError);
+    return false;
+  }
+  return true;
 }
 
+// Resident databases may take this much before clean ones that are not shown are dropped
+static constexpr qint64 kWorkspaceBudgetBytes = 512ll * 1024 * 1024;
+
+struct DbEditorWidget::OpenDb {
+  QString path;
+  CsvTableModel* model = nullptr;
+  RowFilterProxy* proxy = nullptr;
+  std::unique_ptr<EditJournal> journal; // edits since the last commit
+  std::shared_ptr<CsvLoadJob> loadJob;
+  int loadPercent = 0;
+  bool dirty = false;
+  bool compacting = false;
+  bool loadFailed = false; // shown empty and read-only until a load succeeds
+  quint64 lastUsed = 0;
+
+  // View state while another database is shown
+  QString search;
+  bool fuzzy = false;
+  QPersistentModelIndex currentIndex; // proxy index, so it follows sorting and filtering
+  int scrollX = 0;
+  int scrollY = 0;
+
+  ~OpenDb() {
+    if (loadJob) loadJob->cancel();
+    delete proxy;
+    delete model;
+  }
+};
+
 DbEditorWidget::DbEditorWidget(QWidget* parent) : QWidget(parent) {
   auto* v = new QVBoxLayout(this);
 
@@ -96,6 +405,11 @@ DbEditorWidget::DbEditorWidget(QWidget* parent) : QWidget(parent) {
   loadBtn_    = new QPushButton("Load", this);
   saveBtn_    = new QPushButton("Save", this);
   saveAllBtn_ = new QPushButton("Save All", this);
+  backupsBtn_ = new QPushButton("Backups…", this);
+  exportBtn_  = new QPushButton("Export CSV…", this);
+
+  // Backups are copies of the CSV files; the paged file keeps no history
+  backupsBtn_->setVisible(TableStorage::instance().usesCsvFiles());
 
   addRowBtn_  = new QPushButton("Add Row", this);
   delRowBtn_  = new QPushButton("Delete Selected Rows", this);
@@ -108,6 +422,8 @@ DbEditorWidget::DbEditorWidget(QWidget* parent) : QWidget(parent) {
   top->addWidget(loadBtn_);
   top->addWidget(saveBtn_);
   top->addWidget(saveAllBtn_);
+  top->addWidget(backupsBtn_);
+  top->addWidget(exportBtn_);
   top->addWidget(addRowBtn_);
   top->addWidget(delRowBtn_);
   top->addWidget(addColBtn_);
@@ -117,25 +433,36 @@ DbEditorWidget::DbEditorWidget(QWidget* parent) : QWidget(parent) {
   // Search row
   auto* searchRow = new QHBoxLayout();
   search_ = new QLineEdit(this);
-  search_->setPlaceholderText("Search… (filters rows)");
+  search_->setPlaceholderText("Search… (filters rows, e.g. st37  NAME:st37  MinTon>=80 MaxTon<200)");
+  search_->setToolTip("Words match any column. Column terms: Name:text (contains), Name=value, "
+                      "and on numeric columns Name>n, Name>=n, Name<n, Name<=n, Name!=n. "
+                      "All terms must match; use \"double quotes\" for spaces.");
   searchRow->addWidget(search_);
-  v->addLayout(searchRow);
 
-  // Model + Proxy + Table
-  model_ = new CsvTableModel(this);
+  fuzzy_ = new QCheckBox("Fuzzy", this);
+  fuzzy_->setToolTip("Tolerate typos in search text (about one per four characters); best matches first");
+  searchRow->addWidget(fuzzy_);
 
-  proxy_ = new RowFilterProxy(this);
-  proxy_->setSourceModel(model_);
-  proxy_->setFilterCaseSensitivity(Qt::CaseInsensitive);
+  loadProgress_ = new QProgressBar(this);
+  loadProgress_->setRange(0, 100);
+  loadProgress_->setMaximumWidth(160);
+  loadProgress_->setFormat("Loading… %p%");
+  loadProgress_->setVisible(false);
+  searchRow->addWidget(loadProgress_);
+  v->addLayout(searchRow);
 
+  // Table; each database brings its own model + proxy (openDb)
   table_ = new QTableView(this);
-  table_->setModel(proxy_);
   table_->setAlternatingRowColors(true);
-  table_->setSortingEnabled(false);
+  // Unsorted (file order) until a header is clicked; a third click goes back to it
+  table_->horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+  table_->horizontalHeader()->setSortIndicatorClearable(true);
+  table_->setSortingEnabled(true);
   table_->horizontalHeader()->setSectionsClickable(true);
 
   table_->setSelectionBehavior(QAbstractItemView::SelectRows);
   table_->setSelectionMode(QAbstractItemView::ExtendedSelection);
+  editTriggers_ = table_->editTriggers();
 
   v->addWidget(table_, 1);
 
@@ -143,29 +470,21 @@ DbEditorWidget::DbEditorWidget(QWidget* parent) : QWidget(parent) {
   connect(table_->horizontalHeader(), &QHeaderView::sectionClicked,
           this, [this](int logicalIndex) { lastHeaderCol_ = logicalIndex; });
 
-  // Dirty tracking
-  connect(model_, &QAbstractItemModel::dataChanged, this,
-          [this](const QModelIndex&, const QModelIndex&, const QList<int>&) { setDirty(true); });
-  connect(model_, &QAbstractItemModel::rowsInserted, this,
-          [this](const QModelIndex&, int, int) { setDirty(true); });
-  connect(model_, &QAbstractItemModel::rowsRemoved, this,
-          [this](const QModelIndex&, int, int) { setDirty(true); });
-  connect(model_, &QAbstractItemModel::columnsInserted, this,
-          [this](const QModelIndex&, int, int) { setDirty(true); });
-  connect(model_, &QAbstractItemModel::columnsRemoved, this,
-          [this](const QModelIndex&, int, int) { setDirty(true); });
-
   // Search -> proxy regex (escape user input)
-  connect(search_, &QLineEdit::textChanged, this, [this](const QString& t) {
-    QRegularExpression re(QRegularExpression::escape(t),
-                          QRegularExpression::CaseInsensitiveOption);
-    proxy_->setFilterRegularExpression(re);
-  });
+  // Keystrokes are coalesced: the filter runs once typing pauses
+  searchDebounce_ = new QTimer(this);
+  searchDebounce_->setSingleShot(true);
+  searchDebounce_->setInterval(kSearchDebounceMs);
+  connect(search_, &QLineEdit::textChanged, searchDebounce_, qOverload<>(&QTimer::start));
+  connect(searchDebounce_, &QTimer::timeout, this, [this] { proxy_->setSearchText(search_->text()); });
+  connect(fuzzy_, &QCheckBox::toggled, this, [this](bool on) { proxy_->setFuzzy(on); });
 
   // UI connections
   connect(loadBtn_,    &QPushButton::clicked, this, &DbEditorWidget::onLoad);
   connect(saveBtn_,    &QPushButton::clicked, this, &DbEditorWidget::onSave);
   connect(saveAllBtn_, &QPushButton::clicked, this, &DbEditorWidget::onSaveAll);
+  connect(backupsBtn_, &QPushButton::clicked, this, &DbEditorWidget::onBackups);
+  connect(exportBtn_,  &QPushButton::clicked, this, &DbEditorWidget::onExportCsv);
 
   connect(addRowBtn_, &QPushButton::clicked, this, &DbEditorWidget::onAddRow);
   connect(delRowBtn_, &QPushButton::clicked, this, &DbEditorWidget::onDeleteRow);
@@ -177,145 +496,423 @@ DbEditorWidget::DbEditorWidget(QWidget* parent) : QWidget(parent) {
           this, &DbEditorWidget::onDatabaseChanged);
 
   // Initial state
-  lastIndex_ = dbSelector_->currentIndex();
-  currentPath_ = dbSelector_->itemData(lastIndex_).toString();
-  onLoad();
+  showDb(openDb(dbSelector_->currentData().toString()));
 }
 
-void DbEditorWidget::setDirty(bool on) {
-  dirty_ = on;
+DbEditorWidget::~DbEditorWidget() = default;
+
+DbEditorWidget::OpenDb* DbEditorWidget::findDb(const QString& path) const {
+  const auto it = dbs_.find(path);
+  return it != dbs_.end() ? it->second.get() : nullptr;
+}
+
+DbEditorWidget::OpenDb& DbEditorWidget::openDb(const QString& path) {
+  if (OpenDb* db = findDb(path)) return *db;
+
+  OpenDb* db = dbs_.emplace(path, std::make_unique<OpenDb>()).first->second.get();
+  db->path = path;
+  db->model = new CsvTableModel();
+  db->proxy = new RowFilterProxy();
+  db->proxy->setSourceModel(db->model);
+
+  // Dirty tracking + journal: every model change is an edit unless we are loading or replaying
+  auto journal = [this, db](const EditJournal::Record& r) {
+    if (db->journal && !db->loadJob && !journalMuted_) db->journal->record(r);
+  };
+
+  connect(db->model, &QAbstractItemModel::dataChanged, this,
+          [this, db, journal](const QModelIndex& tl, const QModelIndex& br, const QList<int>&) {
+    for (int r = tl.row(); r <= br.row(); ++r) {
+      for (int c = tl.column(); c <= br.column(); ++c) {
+        journal({EditJournal::Op::SetCell, r, c, 0, false, db->model->cellText(r, c)});
+      }
+    }
+    setDirty(*db, true);
+  });
+  connect(db->model, &QAbstractItemModel::rowsInserted, this, [this, db, journal](const QModelIndex&, int first, int last) {
+    if (db->loadJob) return;
+    journal({EditJournal::Op::InsertRows, first, 0, last - first + 1, false, {}});
+    setDirty(*db, true);
+  });
+  connect(db->model, &CsvTableModel::rowRunsRemoved, this, [this, db, journal](const QVector<QPair<int, int>>& runs) {
+    for (const auto& run : runs) journal({EditJournal::Op::RemoveRows, run.first, 0, run.second, false, {}});
+    setDirty(*db, true);
+  });
+  connect(db->model, &QAbstractItemModel::columnsInserted, this, [this, db, journal](const QModelIndex&, int first, int last) {
+    const QStringList headers = db->model->headers();
+    const QSet<QString> numeric = db->model->numericColumns();
+    for (int c = first; c <= last; ++c) {
+      journal({EditJournal::Op::AddColumn, 0, c, 0, numeric.contains(headers[c].trimmed().toLower()), headers[c]});
+    }
+    setDirty(*db, true);
+  });
+  connect(db->model, &QAbstractItemModel::columnsRemoved, this, [this, db, journal](const QModelIndex&, int first, int last) {
+    for (int c = first; c <= last; ++c) journal({EditJournal::Op::RemoveColumn, 0, first, 0, false, {}});
+    setDirty(*db, true);
+  });
+
+  startLoad(*db);
+  return *db;
+}
+
+void DbEditorWidget::showDb(OpenDb& db) {
+  if (current_ == &db) return;
+
+  if (current_) {
+    // A search still being typed belongs to the database it was typed for
+    if (searchDebounce_->isActive()) {
+      searchDebounce_->stop();
+      proxy_->setSearchText(search_->text());
+    }
+    current_->search = search_->text();
+    current_->fuzzy = fuzzy_->isChecked();
+    current_->currentIndex = table_->currentIndex();
+    current_->scrollX = table_->horizontalScrollBar()->value();
+    current_->scrollY = table_->verticalScrollBar()->value();
+  }
+
+  current_ = &db;
+  current_->lastUsed = ++useClock_;
+  currentPath_ = db.path;
+  model_ = db.model;
+  proxy_ = db.proxy;
+
+  // The proxy keeps its filter and sort order; the view only has to point at it
+  QItemSelectionModel* oldSelection = table_->selectionModel();
+  table_->setModel(proxy_);
+  delete oldSelection; // setModel leaves the old selection model to its owner
+  lastHeaderCol_ = -1;
+
+  QHeaderView* header = table_->horizontalHeader();
+  header->blockSignals(true);
+  header->setSortIndicator(proxy_->userSortColumn(), proxy_->sortOrder());
+  header->blockSignals(false);
+
+  search_->blockSignals(true);
+  search_->setText(db.search);
+  search_->blockSignals(false);
+  fuzzy_->blockSignals(true);
+  fuzzy_->setChecked(db.fuzzy);
+  fuzzy_->blockSignals(false);
+
+  setLoading(bool(db.loadJob));
+  loadProgress_->setValue(db.loadPercent);
+  setDirty(db, db.dirty); // window title
+
+  if (db.currentIndex.isValid()) table_->setCurrentIndex(db.currentIndex);
+  else if (proxy_->rowCount() > 0 && proxy_->columnCount() > 0) table_->setCurrentIndex(proxy_->index(0, 0));
+
+  // Scroll ranges only fit the new model once the view has laid it out
+  QTimer::singleShot(0, table_, [view = table_, proxy = proxy_, x = db.scrollX, y = db.scrollY] {
+    if (view->model() != proxy) return;
+    view->horizontalScrollBar()->setValue(x);
+    view->verticalScrollBar()->setValue(y);
+  });
+}
+
+void DbEditorWidget::evictIdle() {
+  qint64 total = 0;
+  for (const auto& [path, db] : dbs_) total += db->model->memoryBytes();
+
+  while (total > kWorkspaceBudgetBytes) {
+    // Least recently shown table that can be reloaded as it is: nothing unsaved, not loading or saving
+    OpenDb* victim = nullptr;
+    for (const auto& [path, db] : dbs_) {
+      if (db.get() == current_ || db->dirty || db->loadJob || db->journal->hasPending() ||
+          pendingSaves_.contains(path)) continue;
+      if (!victim || db->lastUsed < victim->lastUsed) victim = db.get();
+    }
+    if (!victim) return;
+
+    // Coming back then maps the binary cache instead of parsing the CSV again.
+    // Checking the cache hashes the whole CSV, so that happens on a worker too.
+    const QString path = victim->path;
+    if (TableStorage::instance().usesCsvFiles()) {
+      (void)QtConcurrent::run([path] {
+        if (!CsvCache::open(path)) CsvCache::rebuildInBackground(path);
+      });
+    }
+    total -= victim->model->memoryBytes();
+    dbs_.erase(path);
+  }
+}
+
+void DbEditorWidget::setDirty(OpenDb& db, bool on) {
+  db.dirty = on;
+  if (&db != current_) return;
 
   if (auto* w = window()) {
     QString t = w->windowTitle();
     t.remove(" *");
-    if (dirty_) t += " *";
+    if (on) t += " *";
     w->setWindowTitle(t);
   }
 }
 
 void DbEditorWidget::onDatabaseChanged(int idx) {
-  const QString nextPath = dbSelector_->itemData(idx).toString();
-
-  if (dirty_) {
-    auto r = QMessageBox::question(
-        this,
-        "Unsaved changes",
-        "You have unsaved changes. Save before switching database?",
-        QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel);
-
-    if (r == QMessageBox::Cancel) {
-      // revert selection
-      dbSelector_->blockSignals(true);
-      dbSelector_->setCurrentIndex(lastIndex_);
-      dbSelector_->blockSignals(false);
+  // Every database keeps its own edits in memory: switching neither saves nor discards them
+  showDb(openDb(dbSelector_->itemData(idx).toString()));
+  evictIdle();
+}
+
+void DbEditorWidget::onLoad() {
+  startLoad(*current_);
+  setDirty(*current_, false);
+}
+
+void DbEditorWidget::setLoading(bool on) {
+  loadProgress_->setValue(0);
+  loadProgress_->setVisible(on);
+
+  // Read-only until the whole table is in: nothing partial can be edited or saved.
+  // After a failed load it stays that way, so nothing can be saved over the file.
+  const bool editable = !on && !(current_ && current_->loadFailed);
+  for (auto* b : {saveBtn_, saveAllBtn_, backupsBtn_, exportBtn_, addRowBtn_, delRowBtn_, addColBtn_, delColBtn_}) b->setEnabled(editable);
+  table_->setEditTriggers(editable ? editTriggers_ : QAbstractItemView::NoEditTriggers);
+}
+
+void DbEditorWidget::startLoad(OpenDb& db) {
+  if (db.loadJob) db.loadJob->cancel();
+  const QString path = db.path;
+  waitForSaves(path);
+  db.journal = std::make_unique<EditJournal>(path);
+
+  // Load schema first (so model knows numeric columns before edits)
+  loadSchemaIntoModel(path, db.model);
+  db.model->setStore(nullptr);
+  db.loadPercent = 0;
+  db.loadFailed = false;
+  if (&db == current_) setLoading(true);
+
+  // Keeps loading while another database is shown; stops if this one is evicted
+  OpenDb* target = &db;
+  db.loadJob = TableStorage::instance().startLoad(path, db.model, [this, target, path](const CsvLoadJob::Update& u) {
+    const bool shown = target == current_;
+    if (!u.error.isEmpty()) {
+      // A preview may already be in: drop it rather than leave part of the table editable
+      target->loadJob.reset();
+      target->loadFailed = true;
+      target->model->clear();
+      setDirty(*target, false);
+      if (shown) setLoading(false);
+      QMessageBox::critical(this, "Error", "Cannot open: " + path + "\n" + u.error);
       return;
     }
-    if (r == QMessageBox::Yes) {
-      saveDb(currentPath_);
-      setDirty(false);
+
+    const bool first = target->model->columnCount() == 0;
+    if (u.store) target->model->growStore(u.store);
+    else if (u.final) target->model->clear();
+
+    // UX: ensure something is selected (through proxy)
+    if (shown && first && target->proxy->rowCount() > 0 && target->proxy->columnCount() > 0) {
+      table_->setCurrentIndex(target->proxy->index(0, 0));
     }
-    // No = discard changes
-  }
 
-  currentPath_ = nextPath;
-  lastIndex_ = idx;
-  onLoad();
+    target->loadPercent = u.percent;
+    if (shown) loadProgress_->setValue(u.percent);
+    if (u.final) {
+      target->loadJob.reset();
+      if (shown) setLoading(false);
+
+      // Edits committed after the CSV was last written (or before a crash)
+      replayJournal(*target);
+      setDirty(*target, false);
+      target->model->rebuildSearchIndex();
+      startValidation(*target);
+      evictIdle();
+    }
+  });
 }
 
-void DbEditorWidget::onLoad() {
-  loadDb(currentPath_);
-  setDirty(false);
+void DbEditorWidget::startValidation(OpenDb& db) {
+  const TableSchema schema = TableSchema::load(db.path);
+  if (!schema.hasRules()) return;
+
+  // Whole table in one pass on the pool; the report waits for the user, not the load
+  const CsvTableModel::Snapshot snap = db.model->snapshot();
+  auto* watcher = new QFutureWatcher<QVector<TableSchema::Issue>>(this);
+  connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, path = db.path, snap] {
+    watcher->deleteLater();
+    // Row ids only mean the same while the table has not been reloaded
+    const OpenDb* now = findDb(path);
+    const bool sameTable = now && now->model->snapshot().store == snap.store;
+    reportSchemaIssues(this, path, snap, sameTable ? now->model : nullptr, watcher->result());
+  });
+  watcher->setFuture(QtConcurrent::run([schema, snap] { return schema.validate(snap); }));
 }
 
 void DbEditorWidget::onSave() {
-  saveDb(currentPath_);
-  setDirty(false);
+  commitEdits(*current_);
 }
 
 void DbEditorWidget::onSaveAll() {
-  const QString cur = currentPath_;
-  const auto paths = AdminDbPaths::allCsvPaths();
-
-  // Save current view first
-  saveDb(cur);
+  // Only databases with changes are written; no table in memory is reloaded
+  QStringList saving;
+  for (const auto& [path, db] : dbs_) {
+    if (db->loadJob || db->loadFailed || (!db->dirty && EditJournal::committedSize(path) == 0)) continue;
+    startSave(*db);
+    saving << QFileInfo(path).fileName();
+  }
 
-  // Normalize + backup-save the others by loading + saving each
-  for (const auto& p : paths) {
-    if (p == cur) continue;
-    loadDb(p);
-    saveDb(p);
+  // The others can only have changed through their journals (CSV files only)
+  const bool csvFiles = TableStorage::instance().usesCsvFiles();
+  for (const auto& p : csvFiles ? AdminDbPaths::allCsvPaths() : QStringList()) {
+    if (findDb(p) || EditJournal::committedSize(p) == 0) continue;
+    startHeadlessSave(p);
+    saving << QFileInfo(p).fileName();
   }
 
-  // Restore original
-  loadDb(cur);
-  setDirty(false);
+  QMessageBox::information(this, "Save All",
+                           saving.isEmpty() ? "Nothing to save: no database has changes."
+                                            : (csvFiles ? "Saving (with backups):\n" : "Saving:\n") + saving.join("\n"));
+}
+
+void DbEditorWidget::startHeadlessSave(const QString& path) {
+  ++pendingSaves_[path];
+
+  auto* watcher = new QFutureWatcher<SaveResult>(this);
+  connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, path] {
+    watcher->deleteLater();
+    headlessSaves_.remove(path);
+    if (--pendingSaves_[path] == 0) pendingSaves_.remove(path);
+    reportSaveResult(this, watcher->result());
+  });
 
-  QMessageBox::information(this, "Save All", "All databases saved (with backups).");
+  // Not resident, so no save of theirs is queued: these run on the shared pool
+  headlessSaves_.insert(path, watcher);
+  watcher->setFuture(QtConcurrent::run([path] { return foldJournal(path); }));
 }
 
-void DbEditorWidget::loadDb(const QString& path) {
-  // Load schema first (so model knows numeric columns before edits)
-  loadSchemaIntoModel(path, model_);
+void DbEditorWidget::onBackups() {
+  BackupBrowserDialog dlg(currentPath_, this);
+  if (dlg.exec() != QDialog::Accepted || dlg.selectedManifest().isEmpty()) return;
 
-  QFile f(path);
-  if (!f.exists()) {
-    model_->clear();
-    return;
+  const auto r = QMessageBox::question(
+      this,
+      "Restore backup",
+      "Replace " + QFileInfo(currentPath_).fileName() + " with the selected backup?\n"
+      "The current content, unsaved changes included, is kept as a backup first.");
+  if (r != QMessageBox::Yes) return;
+
+  // What is on screen becomes a backup of its own, so the restore can be undone
+  if (current_->dirty || EditJournal::committedSize(currentPath_) > 0) {
+    startSave(*current_);
+    if (!pendingSaves_.contains(currentPath_)) return; // edits could not be committed: keep them
   }
-  if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-    QMessageBox::critical(this, "Error", "Cannot open: " + path);
+  waitForSaves(currentPath_);
+  if (!BackupUtils::makeTimestampedBackupKeepN(currentPath_, this, 10)) return;
+
+  QString error;
+  if (!BackupStore::restore(dlg.selectedManifest(), currentPath_, &error)) {
+    QMessageBox::critical(this, "Restore failed", error);
     return;
   }
+  EditJournal::discard(currentPath_);
+  CsvCache::rebuildInBackground(currentPath_);
+  onLoad();
+}
 
-  QTextStream in(&f);
-  in.setEncoding(QStringConverter::Utf8);
+void DbEditorWidget::onExportCsv() {
+  const QString target = QFileDialog::getSaveFileName(this, "Export CSV", QFileInfo(currentPath_).fileName(),
+                                                      "CSV files (*.csv)");
+  if (target.isEmpty()) return;
 
-  const QString headerRec = CsvUtils::readCsvRecord(in);
-  if (headerRec.isNull() || headerRec.isEmpty()) {
-    model_->clear();
+  // The table as shown, unsaved edits included; the CSV is for other programs, nothing is reloaded from it
+  QSaveFile f(target);
+  if (!f.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    QMessageBox::critical(this, "Error", "Cannot write: " + target);
     return;
   }
+  CsvWriter out(&f);
+  model_->visitCells(out);
+  if (!out.flush() || !f.commit()) QMessageBox::critical(this, "Error", "Cannot write: " + target);
+}
 
-  QStringList headers = CsvUtils::parseCsvRecord(headerRec);
-
-  QVector<QStringList> rows;
-  while (!in.atEnd()) {
-    const QString rec = CsvUtils::readCsvRecord(in);
-    if (rec.isNull() || rec.trimmed().isEmpty()) continue;
+void DbEditorWidget::startSave(OpenDb& db) {
+  // The snapshot must hold exactly the committed edits, so the journal can be cut at the mark
+  // (on the save thread, as the CSV is replaced)
+  const bool journaled = TableStorage::instance().usesCsvFiles();
+  if (journaled && db.journal->hasPending() && !commitJournal(db)) return;
+  const QString path = db.path;
+  saveSchemaFromModel(path, db.model);
+
+  const CsvTableModel::Snapshot snap = db.model->snapshot();
+  const qint64 journalMark = journaled ? EditJournal::committedSize(path) : -1;
+  if (!journaled) db.journal->discardPending(); // the snapshot has them
+  ++pendingSaves_[path];
+  db.compacting = true;
+
+  auto* watcher = new QFutureWatcher<SaveResult>(this);
+  connect(watcher, &QFutureWatcherBase::finished, this,
+          [this, watcher, path, revision = snap.revision] {
+    watcher->deleteLater();
+    if (--pendingSaves_[path] == 0) pendingSaves_.remove(path);
+    OpenDb* db = findDb(path); // never evicted while saving
+    if (db) db->compacting = false;
+
+    if (!reportSaveResult(this, watcher->result())) return;
+
+    // Edits made while the snapshot was being written are still unsaved
+    if (db && db->model->revision() == revision) setDirty(*db, false);
+  });
+  watcher->setFuture(QtConcurrent::run(saveThreadFor(path), [path, snap, journalMark] {
+    return writeSnapshot(path, snap, journalMark);
+  }));
+}
 
-    auto fields = CsvUtils::parseCsvRecord(rec);
-    fields.resize(headers.size());
-    rows.push_back(fields);
+bool DbEditorWidget::commitEdits(OpenDb& db) {
+  // Saving to the paged file only writes the pages that changed: nothing to journal in between
+  if (!TableStorage::instance().usesCsvFiles()) {
+    startSave(db);
+    return true;
   }
 
-  model_->setTable(headers, rows);
+  if (!commitJournal(db)) return false;
 
-  // UX: ensure something is selected (through proxy)
-  if (proxy_->rowCount() > 0 && proxy_->columnCount() > 0) {
-    table_->setCurrentIndex(proxy_->index(0, 0));
-  }
+  // Fold the journal back into the CSV in the background once replaying it gets costly
+  const qint64 limit = std::max(kCompactJournalBytes, QFileInfo(db.path).size() / 8);
+  if (!db.compacting && EditJournal::committedSize(db.path) > limit) startSave(db);
+  return true;
 }
 
-void DbEditorWidget::saveDb(const QString& path) {
-  // Backup CSV (keep last 10)
-  BackupUtils::makeTimestampedBackupKeepN(path, this, 10);
+bool DbEditorWidget::commitJournal(OpenDb& db) {
+  saveSchemaFromModel(db.path, db.model);
 
-  QFile f(path);
-  if (!f.open(QIODevice::WriteOnly | QIODevice::Text)) {
-    QMessageBox::critical(this, "Error", "Cannot write: " + path);
-    return;
+  QString error;
+  if (!db.journal->commit(&error)) {
+    QMessageBox::critical(this, "Error", "Cannot write: " + EditJournal::journalPathFor(db.path) + "\n" + error);
+    return false;
   }
+  setDirty(db, false);
+  return true;
+}
 
-  QTextStream out(&f);
-  out.setEncoding(QStringConverter::Utf8);
+void DbEditorWidget::replayJournal(OpenDb& db) {
+  if (!TableStorage::instance().usesCsvFiles()) return; // journals belong to the CSV files
+  const QVector<EditJournal::Record> records = EditJournal::readCommitted(db.path);
+  if (records.isEmpty()) return;
 
-  out << CsvUtils::encodeCsvRecord(model_->headers()) << "\n";
-  for (const auto& row : model_->rows()) {
-    out << CsvUtils::encodeCsvRecord(row) << "\n";
+  const bool wasMuted = journalMuted_;
+  journalMuted_ = true;
+  EditJournal::apply(*db.model, records);
+  journalMuted_ = wasMuted;
+}
+
+QThreadPool* DbEditorWidget::saveThreadFor(const QString& path) {
+  QThreadPool*& pool = saveThreads_[path];
+  if (!pool) {
+    // Destroyed with the widget, and waits for any save still running
+    pool = new QThreadPool(this);
+    pool->setMaxThreadCount(1);
   }
+  return pool;
+}
 
-  // Save schema (no backups needed; it changes rarely, but you can add if you want)
-  saveSchemaFromModel(path, model_);
+void DbEditorWidget::waitForSaves(const QString& path) {
+  // Never read a file that a queued save is about to replace
+  if (!pendingSaves_.contains(path)) return;
+  if (QThreadPool* pool = saveThreads_.value(path)) pool->waitForDone();
+  if (QFutureWatcherBase* w = headlessSaves_.value(path)) w->waitForFinished();
 }
 
 void DbEditorWidget::onAddRow() {
@@ -346,20 +943,15 @@ void DbEditorWidget::onDeleteRow() {
 
   if (reply != QMessageBox::Yes) return;
 
-  // Map proxy rows -> source rows
-  std::vector<int> sourceRows;
-  sourceRows.reserve(static_cast<size_t>(selected.size()));
+  // Map proxy rows -> source rows; the model merges them into runs and removes them in one go
+  QVector<int> sourceRows;
+  sourceRows.reserve(selected.size());
   for (const auto& pIdx : selected) {
     const int srcRow = proxy_->mapToSource(pIdx).row();
     if (srcRow >= 0) sourceRows.push_back(srcRow);
   }
 
-  // Unique + sort descending
-  std::sort(sourceRows.begin(), sourceRows.end());
-  sourceRows.erase(std::unique(sourceRows.begin(), sourceRows.end()), sourceRows.end());
-  std::sort(sourceRows.rbegin(), sourceRows.rend());
-
-  for (int r : sourceRows) model_->deleteRow(r);
+  model_->removeRows(std::move(sourceRows));
 }
 
 void DbEditorWidget::onAddColumn() {
@@ -0,0 +1,285 @@
+#include "EditJournal.hpp"
+#include "CsvTableModel.hpp"
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+// File layout, host byte order:
+//   Header:     the CSV it extends (size + mtime); during a compaction also the one replacing it
+//   per record: u32 payload bytes | u16 CRC-16 of payload | payload
+//   payload:    u8 op | u8 numeric | i32 row | i32 col | i32 count | UTF-8 text (rest)
+// A crash can only tear the last record; it fails its length or checksum and is cut off.
+constexpr char kMagic[8] = {'P', 'B', 'J', 'R', 'N', 'L', '\0', '\2'};
+
+struct Header {
+  char magic[8];
+  qint64 csvSize;
+  qint64 csvMtime;  // ms since epoch
+  qint64 nextSize;  // -1, or the CSV a compaction is putting in place: it holds the records
+  qint64 nextMtime; // before nextKeepFrom, so only the rest apply to it
+  qint64 nextKeepFrom;
+};
+
+constexpr qsizetype kFrameBytes = sizeof(quint32) + sizeof(quint16);
+constexpr qsizetype kFixedPayloadBytes = 2 + 3 * sizeof(qint32);
+
+Header headerFor(const QString& csvPath) {
+  const QFileInfo csv(csvPath);
+  Header h{};
+  std::memcpy(h.magic, kMagic, sizeof(kMagic));
+  h.csvSize = csv.exists() ? csv.size() : -1;
+  h.csvMtime = csv.exists() ? csv.lastModified().toMSecsSinceEpoch() : 0;
+  h.nextSize = -1;
+  return h;
+}
+
+bool readHeader(const QByteArray& bytes, Header& h) {
+  if (bytes.size() < qsizetype(sizeof(Header))) return false;
+  std::memcpy(&h, bytes.constData(), sizeof(Header));
+  return std::memcmp(h.magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+template <typename T>
+void put(QByteArray& out, T v) {
+  out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template <typename T>
+T get(const char* p) {
+  T v;
+  std::memcpy(&v, p, sizeof(T));
+  return v;
+}
+
+bool syncToDisk(QFile& f) {
+  if (!f.flush()) return false;
+#ifdef Q_OS_WIN
+  return _commit(f.handle()) == 0;
+#else
+  return ::fsync(f.handle()) == 0;
+#endif
+}
+
+// Commits from the GUI thread and compactions on save workers touch the same files
+QMutex& journalMutex() {
+  static QMutex m;
+  return m;
+}
+
+// Replaces the journal with `tail` (whole records) after a header for the CSV as it is now
+bool writeRebased(const QString& csvPath, const QByteArray& tail) {
+  const QString path = EditJournal::journalPathFor(csvPath);
+  if (tail.isEmpty()) return !QFile::exists(path) || QFile::remove(path);
+
+  const Header h = headerFor(csvPath);
+  QSaveFile out(path);
+  if (!out.open(QIODevice::WriteOnly)) return false;
+  out.write(reinterpret_cast<const char*>(&h), sizeof(Header));
+  out.write(tail);
+  return out.commit();
+}
+
+} // namespace
+
+EditJournal::EditJournal(QString csvPath) : csvPath_(std::move(csvPath)) {}
+
+QString EditJournal::journalPathFor(const QString& csvPath) {
+  return csvPath + ".journal";
+}
+
+void EditJournal::record(const Record& r) {
+  const QByteArray text = r.text.toUtf8();
+
+  QByteArray payload;
+  payload.reserve(kFixedPayloadBytes + text.size());
+  put<quint8>(payload, quint8(r.op));
+  put<quint8>(payload, r.numeric ? 1 : 0);
+  put<qint32>(payload, r.row);
+  put<qint32>(payload, r.col);
+  put<qint32>(payload, r.count);
+  payload.append(text);
+
+  put<quint32>(pending_, quint32(payload.size()));
+  put<quint16>(pending_, qChecksum(payload));
+  pending_.append(payload);
+}
+
+bool EditJournal::commit(QString* error) {
+  if (pending_.isEmpty()) return true;
+
+  QMutexLocker lock(&journalMutex());
+  const QString path = journalPathFor(csvPath_);
+
+  // Stale journals are dropped when read at load time, so an existing one is appended to
+  // (even while a compaction is replacing the CSV: rebase() then carries these records over)
+  QByteArray head;
+  {
+    QFile existing(path);
+    if (existing.open(QIODevice::ReadOnly)) head = existing.read(sizeof(Header));
+  }
+  Header h;
+  const bool fresh = !readHeader(head, h);
+  if (fresh) h = headerFor(csvPath_);
+
+  QFile f(path);
+  if (!f.open(fresh ? QIODevice::WriteOnly | QIODevice::Truncate : QIODevice::WriteOnly | QIODevice::Append)) {
+    if (error) *error = f.errorString();
+    return false;
+  }
+
+  if (fresh && f.write(reinterpret_cast<const char*>(&h), sizeof(Header)) != qint64(sizeof(Header))) {
+    if (error) *error = f.errorString();
+    return false;
+  }
+
+  // All edits since the last save go down in one write and one fsync
+  if (f.write(pending_) != pending_.size() || !syncToDisk(f)) {
+    if (error) *error = f.errorString();
+    return false;
+  }
+
+  pending_.clear();
+  return true;
+}
+
+qint64 EditJournal::committedSize(const QString& csvPath) {
+  const QFileInfo fi(journalPathFor(csvPath));
+  return fi.exists() && fi.size() > qint64(sizeof(Header)) ? fi.size() : 0; // a bare header holds no edits
+}
+
+QVector<EditJournal::Record> EditJournal::readCommitted(const QString& csvPath) {
+  QMutexLocker lock(&journalMutex());
+  QFile f(journalPathFor(csvPath));
+  if (!f.open(QIODevice::ReadWrite)) return {};
+
+  const QByteArray bytes = f.readAll();
+  Header h;
+  const Header expected = headerFor(csvPath);
+  const bool valid = readHeader(bytes, h);
+  qsizetype pos = sizeof(Header);
+  bool compacted = false;
+  if (valid && h.csvSize == expected.csvSize && h.csvMtime == expected.csvMtime) {
+    // The CSV it was written against
+  } else if (valid && h.nextSize >= 0 && h.nextSize == expected.csvSize && h.nextMtime == expected.csvMtime &&
+             h.nextKeepFrom >= pos && h.nextKeepFrom <= bytes.size()) {
+    // Stopped between replacing the CSV and rebasing: the new CSV already has the records before the mark
+    pos = qsizetype(h.nextKeepFrom);
+    compacted = true;
+  } else {
+    // Written against another version of the CSV (edited elsewhere, restored): it no longer applies
+    f.close();
+    QFile::remove(journalPathFor(csvPath));
+    return {};
+  }
+
+  QVector<Record> out;
+  const qsizetype first = pos;
+  while (bytes.size() - pos >= kFrameBytes) {
+    const quint32 size = get<quint32>(bytes.constData() + pos);
+    const quint16 crc = get<quint16>(bytes.constData() + pos + sizeof(quint32));
+    if (size < quint32(kFixedPayloadBytes) || size > quint64(bytes.size() - pos - kFrameBytes)) break;
+
+    const QByteArrayView payload(bytes.constData() + pos + kFrameBytes, qsizetype(size));
+    if (qChecksum(payload) != crc) break;
+
+    const char* p = payload.data();
+    Record r;
+    r.op = Op(get<quint8>(p));
+    r.numeric = get<quint8>(p + 1) != 0;
+    r.row = get<qint32>(p + 2);
+    r.col = get<qint32>(p + 6);
+    r.count = get<qint32>(p + 10);
+    r.text = QString::fromUtf8(p + kFixedPayloadBytes, payload.size() - kFixedPayloadBytes);
+    if (r.op < Op::SetCell || r.op > Op::RemoveColumn) break;
+
+    out.push_back(std::move(r));
+    pos += kFrameBytes + qsizetype(size);
+  }
+
+  // Cut off a torn tail so the next commit appends after the last good record
+  if (compacted) {
+    f.close();
+    writeRebased(csvPath, bytes.mid(first, pos - first));
+  } else if (pos < bytes.size()) {
+    f.resize(pos);
+  }
+  return out;
+}
+
+bool EditJournal::prepareRebase(const QString& csvPath, qint64 keepFrom, qint64 nextSize, qint64 nextMtime) {
+  QMutexLocker lock(&journalMutex());
+  QFile f(journalPathFor(csvPath));
+  if (!f.open(QIODevice::ReadWrite)) return false;
+
+  // A journal started during the compaction must know about it too, so one is created if missing
+  Header h;
+  if (!readHeader(f.read(sizeof(Header)), h)) {
+    h = headerFor(csvPath);
+    if (!f.resize(0)) return false;
+  }
+  h.nextSize = nextSize;
+  h.nextMtime = nextMtime;
+  h.nextKeepFrom = std::max<qint64>(keepFrom, sizeof(Header));
+  return f.seek(0) && f.write(reinterpret_cast<const char*>(&h), sizeof(Header)) == qint64(sizeof(Header)) &&
+         syncToDisk(f);
+}
+
+bool EditJournal::rebase(const QString& csvPath, qint64 keepFrom) {
+  QMutexLocker lock(&journalMutex());
+  keepFrom = std::max<qint64>(keepFrom, sizeof(Header));
+  QByteArray tail;
+  {
+    QFile f(journalPathFor(csvPath));
+    if (!f.open(QIODevice::ReadOnly)) return true;
+    if (f.size() > keepFrom && f.seek(keepFrom)) tail = f.readAll();
+  }
+
+  // Records committed while the compacted CSV was being written extend the new CSV
+  return writeRebased(csvPath, tail);
+}
+
+void EditJournal::discard(const QString& csvPath) {
+  QMutexLocker lock(&journalMutex());
+  QFile::remove(journalPathFor(csvPath));
+}
+
+void EditJournal::apply(CsvTableModel& model, const QVector<Record>& records) {
+  for (const auto& r : records) {
+    bool ok = true;
+    switch (r.op) {
+      case Op::SetCell:
+        ok = r.row >= 0 && r.row < model.rowCount() && r.col >= 0 && r.col < model.columnCount();
+        if (ok) model.setData(model.index(r.row, r.col), r.text, Qt::EditRole);
+        break;
+      case Op::InsertRows:
+        ok = model.insertRows(r.row, r.count);
+        break;
+      case Op::RemoveRows:
+        ok = model.removeRows(r.row, r.count);
+        break;
+      case Op::AddColumn:
+        model.addColumn(r.text, r.numeric);
+        break;
+      case Op::RemoveColumn:
+        ok = r.col >= 0 && r.col < model.columnCount();
+        if (ok) model.deleteColumn(r.col);
+        break;
+    }
+    if (!ok) break; // does not fit this table: stop rather than apply edits to the wrong cells
+  }
+}
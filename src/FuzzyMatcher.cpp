@@ -0,0 +1,47 @@
+#include "FuzzyMatcher.hpp"
+
+FuzzyMatcher::FuzzyMatcher(QStringView pattern) {
+  const QString folded = pattern.toString().toCaseFolded();
+  if (folded.isEmpty() || folded.size() > kMaxPattern) return;
+
+  for (int i = 0; i < folded.size(); ++i) {
+    const char16_t c = folded[i].unicode();
+    if (c < ascii_.size()) ascii_[c] |= quint64(1) << i;
+    else other_[c] |= quint64(1) << i;
+  }
+  length_ = int(folded.size());
+}
+
+int FuzzyMatcher::distance(QStringView text, int limit) const {
+  // Pv/Mv: +1/-1 vertical deltas of the current DP column. The top row stays 0 (a match may start
+  // anywhere), so nothing is shifted in at the bottom. `score` tracks the last pattern row.
+  const quint64 last = quint64(1) << (length_ - 1);
+  quint64 pv = ~quint64(0);
+  quint64 mv = 0;
+  int score = length_;
+  int best = length_;
+
+  for (qsizetype i = 0; i < text.size(); ++i) {
+    const quint64 eq = peq(char16_t(QChar::toCaseFolded(char32_t(text[i].unicode()))));
+    const quint64 xv = eq | mv;
+    const quint64 xh = (((eq & pv) + pv) ^ pv) | eq;
+    quint64 ph = mv | ~(xh | pv);
+    quint64 mh = pv & xh;
+
+    if (ph & last) ++score;
+    else if (mh & last) --score;
+
+    ph <<= 1;
+    mh <<= 1;
+    pv = mh | ~(xv | ph);
+    mv = ph & xv;
+
+    if (score < best) {
+      best = score;
+      if (best == 0) return 0;
+    }
+    // The score falls by at most one per remaining character
+    if (score - (text.size() - 1 - i) > limit && best > limit) return limit + 1;
+  }
+  return best;
+}
@@ -0,0 +1,66 @@
+#include "MappedCsvStore.hpp"
+
+std::shared_ptr<MappedCsvStore> MappedCsvStore::open(const QString& path, QString* error) {
+  std::shared_ptr<MappedCsvStore> store(new MappedCsvStore());
+
+  store->file_.setFileName(path);
+  if (!store->file_.open(QIODevice::ReadOnly)) {
+    if (error) *error = store->file_.errorString();
+    return nullptr;
+  }
+
+  const qint64 size = store->file_.size();
+  uchar* mapped = size > 0 ? store->file_.map(0, size) : nullptr;
+  if (!mapped) {
+    if (error) *error = size > 0 ? store->file_.errorString() : QString("File is empty");
+    return nullptr;
+  }
+  store->data_ = reinterpret_cast<const char*>(mapped);
+
+  store->records_ = CsvTokenizer::indexRecords(store->data_, size);
+  if (store->records_.isEmpty()) {
+    if (error) *error = "No header record";
+    return nullptr;
+  }
+  store->headers_ = CsvTokenizer::splitRecord(store->data_, store->records_.first());
+  return store;
+}
+
+QString MappedCsvStore::cell(int row, int col) const {
+  if (row < 0 || row + 1 >= records_.size()) return {};
+  if (col < 0 || col >= headers_.size()) return {};
+
+  CsvTokenizer::Field f;
+  if (!CsvTokenizer::findField(data_, records_[row + 1], col, f)) return {};
+  return CsvTokenizer::decodeField(data_, f);
+}
+
+void MappedCsvStore::writeCell(int row, int col, CsvCellSink& sink) const {
+  CsvTokenizer::Field f;
+  if (row < 0 || row + 1 >= records_.size() || col < 0 || col >= headers_.size() ||
+      !CsvTokenizer::findField(data_, records_[row + 1], col, f)) {
+    sink.text({});
+    return;
+  }
+
+  if (f.plain) {
+    sink.utf8(QByteArrayView(data_ + f.begin, f.size));
+    return;
+  }
+  QByteArray unescaped;
+  CsvTokenizer::appendFieldUtf8(unescaped, data_, f);
+  sink.utf8(unescaped);
+}
+
+bool MappedCsvStore::viewUtf8(int row, int col, QByteArrayView& out) const {
+  if (row < 0 || row + 1 >= records_.size() || col < 0 || col >= headers_.size()) return false;
+
+  CsvTokenizer::Field f;
+  if (!CsvTokenizer::findField(data_, records_[row + 1], col, f)) {
+    out = {}; // shorter record: empty cell
+    return true;
+  }
+  if (!f.plain) return false; // quotes to undo
+  out = QByteArrayView(data_ + f.begin, f.size);
+  return true;
+}
@@ -0,0 +1,113 @@
+#include "NumberParser.hpp"
+
+#include <QByteArray>
+#include <QChar>
+#include <QString>
+
+#include <charconv>
+
+namespace {
+
+// Longer numbers than this (digits, point, sign) take the slow path below
+constexpr qsizetype kMaxChars = 64;
+
+bool isSpace(char16_t c) {
+  if (c < 0x80) return c == ' ' || (c >= '\t' && c <= '\r');
+  return QChar::isSpace(c);
+}
+
+enum class Scan { NotNumber, Number, TooLong };
+
+// Shared by both encodings: `Char` is char16_t or char. UTF-8 text only has ASCII here,
+// callers send anything else to the decoding path.
+template <typename Char>
+Scan scan(const Char* p, qsizetype n, double& out) {
+  qsizetype begin = 0;
+  qsizetype end = n;
+  while (begin < end && isSpace(char16_t(p[begin]))) ++begin;
+  while (end > begin && isSpace(char16_t(p[end - 1]))) --end;
+  if (end - begin > kMaxChars) return Scan::TooLong;
+
+  // [+-] digits [(. or ,) digits], at least one digit; copied narrowed, with a dot, for from_chars
+  char buf[kMaxChars];
+  qsizetype len = 0;
+  qsizetype i = begin;
+  if (i < end && (p[i] == '+' || p[i] == '-')) {
+    if (p[i] == '-') buf[len++] = '-'; // from_chars takes no '+'
+    ++i;
+  }
+  int digits = 0;
+  bool point = false;
+  for (; i < end; ++i) {
+    const Char c = p[i];
+    if (c >= '0' && c <= '9') {
+      buf[len++] = char(c);
+      ++digits;
+    } else if ((c == '.' || c == ',') && !point) {
+      buf[len++] = '.';
+      point = true;
+    } else {
+      return Scan::NotNumber;
+    }
+  }
+  if (digits == 0) return Scan::NotNumber;
+
+#if defined(__cpp_lib_to_chars)
+  double v = 0.0;
+  const auto r = std::from_chars(buf, buf + len, v, std::chars_format::fixed);
+  if (r.ec != std::errc() || r.ptr != buf + len) return Scan::NotNumber;
+#else
+  // Standard library without floating-point from_chars: the same digits through Qt, not copied
+  bool ok = false;
+  const double v = QByteArray::fromRawData(buf, len).toDouble(&ok);
+  if (!ok) return Scan::NotNumber;
+#endif
+  out = v;
+  return Scan::Number;
+}
+
+// Rare inputs the fast scan cannot take: very long digit runs, non-ASCII bytes in UTF-8
+bool parseSlow(QString s, double& out) {
+  s = s.trimmed();
+  if (s.size() <= kMaxChars) return scan(reinterpret_cast<const char16_t*>(s.utf16()), s.size(), out) == Scan::Number;
+
+  s.replace(',', '.');
+  qsizetype i = s.startsWith('+') || s.startsWith('-') ? 1 : 0;
+  int digits = 0;
+  bool point = false;
+  for (; i < s.size(); ++i) {
+    if (s[i].unicode() >= '0' && s[i].unicode() <= '9') ++digits;
+    else if (s[i] == '.' && !point) point = true;
+    else return false;
+  }
+  if (digits == 0) return false;
+
+  bool ok = false;
+  out = s.toDouble(&ok);
+  return ok;
+}
+
+} // namespace
+
+bool NumberParser::parse(QStringView text, double& out) {
+  const Scan r = scan(reinterpret_cast<const char16_t*>(text.utf16()), text.size(), out);
+  return r == Scan::TooLong ? parseSlow(text.toString(), out) : r == Scan::Number;
+}
+
+bool NumberParser::parse(QByteArrayView utf8, double& out) {
+  for (const char c : utf8) {
+    if (uchar(c) >= 0x80) return parseSlow(QString::fromUtf8(utf8), out); // e.g. a no-break space
+  }
+  const Scan r = scan(utf8.data(), utf8.size(), out);
+  return r == Scan::TooLong ? parseSlow(QString::fromLatin1(utf8), out) : r == Scan::Number;
+}
+
+int NumberParser::parseColumn(const char* arena, const quint32* offsets, int rows, double* values, quint64* valid) {
+  for (int r = 0; r < rows; ++r) {
+    const QByteArrayView cell(arena + offsets[r], qsizetype(offsets[r + 1] - offsets[r]));
+    if (cell.isEmpty()) continue;
+    if (!parse(cell, values[r])) return r;
+    valid[r / 64] |= quint64(1) << (r % 64);
+  }
+  return -1;
+}
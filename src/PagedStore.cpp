@@ -0,0 +1,666 @@
+#include "PagedStore.hpp"
+#include "ColumnarCsvStore.hpp"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSet>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Page layouts, host byte order:
+//   header  magic | u32 page size | u32 page count | u32 catalog | u32 free list
+//   chain   u32 next page (0 = last) | u32 bytes used | payload
+//   free    u32 next free page | unused
+//   data    u16 slot count | u16 start of records | slots (u16 offset, u16 length) ... records
+//           records fill the page from its end towards the slots
+// Record: u32 cell count, then per cell u32 length | UTF-8.
+// A row is addressed by a locator: data page << 16 | slot, or chain head << 16 | kChainSlot.
+// Log: per page u32 page number | page, then u32 kCommitMark | u32 page count | u64 FNV-1a of
+// everything before the mark.
+constexpr char kMagic[8] = {'P', 'B', 'P', 'A', 'G', 'E', 'D', '\1'};
+
+constexpr qsizetype kChainPayload = PagedStore::kPageSize - 2 * sizeof(quint32);
+constexpr qsizetype kDataHeader = 2 * sizeof(quint16);
+constexpr qsizetype kSlotBytes = 2 * sizeof(quint16);
+constexpr qsizetype kBigRecord = PagedStore::kPageSize / 2;
+constexpr quint16 kChainSlot = 0xFFFF;
+constexpr quint32 kCommitMark = 0xFFFFFFFF;
+
+// Page cache of the committed file: 32 MiB
+constexpr int kCachePages = 4096;
+
+// Dead records are only worth a rewrite once there is some volume of them
+constexpr quint64 kMinDeadBytes = 16 * PagedStore::kPageSize;
+
+template <typename T>
+T get(const char* p) {
+  T v;
+  std::memcpy(&v, p, sizeof(T));
+  return v;
+}
+
+template <typename T>
+void set(QByteArray& page, qsizetype at, T v) {
+  std::memcpy(page.data() + at, &v, sizeof(T));
+}
+
+template <typename T>
+void append(QByteArray& out, T v) {
+  out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+bool syncToDisk(QFile& f) {
+  if (!f.flush()) return false;
+#ifdef Q_OS_WIN
+  return _commit(f.handle()) == 0;
+#else
+  return ::fsync(f.handle()) == 0;
+#endif
+}
+
+quint64 checksum(const char* p, qsizetype n) {
+  quint64 h = 14695981039346656037ull;
+  for (qsizetype i = 0; i < n; ++i) {
+    h ^= uchar(p[i]);
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+bool writePages(QFile& file, const QHash<quint32, QByteArray>& pages) {
+  for (auto it = pages.constBegin(); it != pages.constEnd(); ++it) {
+    if (!file.seek(qint64(it.key()) * PagedStore::kPageSize) || file.write(*it) != it->size()) return false;
+  }
+  return syncToDisk(file);
+}
+
+quint64 locator(quint32 page, quint16 slot) {
+  return (quint64(page) << 16) | slot;
+}
+
+quint32 locatorPage(quint64 loc) {
+  return quint32(loc >> 16);
+}
+
+quint16 locatorSlot(quint64 loc) {
+  return quint16(loc & 0xFFFF);
+}
+
+QByteArray encodeRecord(const QStringList& cells) {
+  QByteArray out;
+  append<quint32>(out, quint32(cells.size()));
+  for (const QString& cell : cells) {
+    const QByteArray utf8 = cell.toUtf8();
+    append<quint32>(out, quint32(utf8.size()));
+    out.append(utf8);
+  }
+  return out;
+}
+
+// Cut-off records give what they hold; the table keeps its shape either way
+QStringList decodeRecord(const QByteArray& record) {
+  QStringList cells;
+  if (record.size() < qsizetype(sizeof(quint32))) return cells;
+  const char* p = record.constData();
+  const quint32 count = get<quint32>(p);
+  qsizetype at = sizeof(quint32);
+  for (quint32 i = 0; i < count && at + qsizetype(sizeof(quint32)) <= record.size(); ++i) {
+    const qsizetype len = get<quint32>(p + at);
+    at += sizeof(quint32);
+    if (at + len > record.size()) break;
+    cells << QString::fromUtf8(p + at, len);
+    at += len;
+  }
+  return cells;
+}
+
+QVector<quint64> decodeLocators(const QByteArray& bytes, quint32 rows) {
+  QVector<quint64> out(std::min<qsizetype>(rows, bytes.size() / qsizetype(sizeof(quint64))));
+  std::memcpy(out.data(), bytes.constData(), size_t(out.size()) * sizeof(quint64));
+  return out;
+}
+
+QVector<quint32> decodePages(const QByteArray& bytes) {
+  QVector<quint32> out(bytes.size() / qsizetype(sizeof(quint32)));
+  std::memcpy(out.data(), bytes.constData(), size_t(out.size()) * sizeof(quint32));
+  return out;
+}
+
+QByteArray encodePages(const QVector<quint32>& pages) {
+  return QByteArray(reinterpret_cast<const char*>(pages.constData()), pages.size() * qsizetype(sizeof(quint32)));
+}
+
+// Row ids with an edited cell: overlay keys are row id << 32 | column id
+QSet<int> editedRows(const CsvTableModel::Snapshot& snap) {
+  QSet<int> out;
+  for (auto it = snap.overlay.keyBegin(); it != snap.overlay.keyEnd(); ++it) out.insert(int(*it >> 32));
+  return out;
+}
+
+int rowIdLimit(const CsvTableModel::Snapshot& snap) {
+  return snap.rowIds.isEmpty() ? 0 : *std::max_element(snap.rowIds.cbegin(), snap.rowIds.cend()) + 1;
+}
+
+QByteArray rowRecord(const CsvTableModel::Snapshot& snap, int row) {
+  QStringList cells;
+  for (int c = 0; c < snap.columnCount(); ++c) cells << snap.cellText(row, c);
+  return encodeRecord(cells);
+}
+
+// A table as loaded from the paged file: decoded columns plus where each row came from
+class PagedTableStore : public CsvBackingStore {
+public:
+  PagedTableStore(const PagedStore* owner, QString name, quint64 generation,
+                  std::shared_ptr<const ColumnarCsvStore> cells, QVector<quint64> locators)
+    : owner_(owner), name_(std::move(name)), generation_(generation),
+      cells_(std::move(cells)), locators_(std::move(locators)) {}
+
+  QStringList headers() const override { return cells_->headers(); }
+  int rowCount() const override { return cells_->rowCount(); }
+  int columnCount() const override { return cells_->columnCount(); }
+  QString cell(int row, int col) const override { return cells_->cell(row, col); }
+  void writeCell(int row, int col, CsvCellSink& sink) const override { cells_->writeCell(row, col, sink); }
+  bool number(int row, int col, double& out) const override { return cells_->number(row, col, out); }
+  bool viewUtf8(int row, int col, QByteArrayView& out) const override { return cells_->viewUtf8(row, col, out); }
+  const QStringList* dictionary(int col) const override { return cells_->dictionary(col); }
+  int dictionaryCode(int row, int col) const override { return cells_->dictionaryCode(row, col); }
+  qint64 memoryBytes() const override { return cells_->memoryBytes() + locators_.capacity() * qint64(sizeof(quint64)); }
+
+  const PagedStore* owner() const { return owner_; }
+  const QString& name() const { return name_; }
+  quint64 generation() const { return generation_; }
+  const QVector<quint64>& locators() const { return locators_; } // by load-time row id
+
+private:
+  const PagedStore* owner_;
+  QString name_;
+  quint64 generation_;
+  std::shared_ptr<const ColumnarCsvStore> cells_;
+  QVector<quint64> locators_;
+};
+
+} // namespace
+
+PagedStore::PagedStore(QString path)
+  : path_(std::move(path)), cache_(kCachePages) {}
+
+PagedStore::~PagedStore() = default;
+
+bool PagedStore::open(QString* error) {
+  if (opened_) return true;
+
+  QDir().mkpath(QFileInfo(path_).absolutePath());
+  file_.setFileName(path_);
+  wal_.setFileName(path_ + "-wal");
+  if (!file_.open(QIODevice::ReadWrite) || !wal_.open(QIODevice::ReadWrite)) {
+    if (error) *error = QString("Cannot open %1: %2").arg(path_, file_.isOpen() ? wal_.errorString() : file_.errorString());
+    file_.close();
+    return false;
+  }
+  if (!recover(error)) {
+    file_.close();
+    wal_.close();
+    return false;
+  }
+
+  if (file_.size() > 0) {
+    const QByteArray head = page(0);
+    if (std::memcmp(head.constData(), kMagic, sizeof(kMagic)) != 0 || get<quint32>(head.constData() + 8) != quint32(kPageSize)) {
+      if (error) *error = QString("%1 is not a table file of this program").arg(path_);
+      file_.close();
+      wal_.close();
+      cache_.clear();
+      return false;
+    }
+    header_.pageCount = get<quint32>(head.constData() + 12);
+    header_.catalog = get<quint32>(head.constData() + 16);
+    header_.freeList = get<quint32>(head.constData() + 20);
+  }
+  committedHeader_ = header_;
+  opened_ = true;
+  return true;
+}
+
+// A log with its commit mark is written out again; anything less never happened
+bool PagedStore::recover(QString* error) {
+  if (wal_.size() == 0) return true;
+
+  wal_.seek(0);
+  const QByteArray log = wal_.readAll();
+  const qsizetype frame = sizeof(quint32) + kPageSize;
+  QHash<quint32, QByteArray> pages;
+  quint32 frames = 0;
+  bool committed = false;
+  qsizetype at = 0;
+  while (at + qsizetype(sizeof(quint32)) <= log.size()) {
+    const quint32 no = get<quint32>(log.constData() + at);
+    if (no == kCommitMark) {
+      if (at + 16 <= log.size()) {
+        committed = get<quint32>(log.constData() + at + 4) == frames &&
+                    get<quint64>(log.constData() + at + 8) == checksum(log.constData(), at);
+      }
+      break;
+    }
+    if (at + frame > log.size()) break;
+    pages.insert(no, log.mid(at + sizeof(quint32), kPageSize));
+    ++frames;
+    at += frame;
+  }
+
+  if (committed && !writePages(file_, pages)) {
+    if (error) *error = QString("Cannot recover %1: %2").arg(path_, file_.errorString());
+    return false;
+  }
+  return wal_.resize(0);
+}
+
+QByteArray PagedStore::page(quint32 no) {
+  if (const auto it = dirty_.constFind(no); it != dirty_.constEnd()) return *it;
+  if (const QByteArray* cached = cache_.object(no)) return *cached;
+
+  // Pages past the end of the file were allocated but never differed from zeros
+  QByteArray bytes(kPageSize, '\0');
+  if (qint64(no) * kPageSize < file_.size() && file_.seek(qint64(no) * kPageSize)) file_.read(bytes.data(), kPageSize);
+  cache_.insert(no, new QByteArray(bytes));
+  return bytes;
+}
+
+void PagedStore::put(quint32 no, const QByteArray& bytes) {
+  if (page(no) == bytes) return;
+  dirty_.insert(no, bytes);
+}
+
+quint32 PagedStore::allocate() {
+  if (header_.freeList == 0) return header_.pageCount++;
+  const quint32 no = header_.freeList;
+  header_.freeList = get<quint32>(page(no).constData());
+  return no;
+}
+
+void PagedStore::release(quint32 no) {
+  QByteArray free(kPageSize, '\0');
+  set<quint32>(free, 0, header_.freeList);
+  put(no, free);
+  header_.freeList = no;
+}
+
+bool PagedStore::commit(QString* error) {
+  QByteArray head(kPageSize, '\0');
+  std::memcpy(head.data(), kMagic, sizeof(kMagic));
+  set<quint32>(head, 8, quint32(kPageSize));
+  set<quint32>(head, 12, header_.pageCount);
+  set<quint32>(head, 16, header_.catalog);
+  set<quint32>(head, 20, header_.freeList);
+  put(0, head);
+  if (dirty_.isEmpty()) return true;
+
+  // 1) Every changed page plus the commit mark, made durable with one fsync
+  QByteArray log;
+  log.reserve(dirty_.size() * (sizeof(quint32) + kPageSize) + 16);
+  for (auto it = dirty_.constBegin(); it != dirty_.constEnd(); ++it) {
+    append<quint32>(log, it.key());
+    log.append(*it);
+  }
+  const quint64 sum = checksum(log.constData(), log.size());
+  append<quint32>(log, kCommitMark);
+  append<quint32>(log, quint32(dirty_.size()));
+  append<quint64>(log, sum);
+  if (!wal_.resize(0) || !wal_.seek(0) || wal_.write(log) != log.size() || !syncToDisk(wal_)) {
+    if (error) *error = QString("Cannot write %1: %2").arg(wal_.fileName(), wal_.errorString());
+    wal_.resize(0);
+    rollback();
+    return false;
+  }
+
+  // 2) The pages in place; should this be cut short, the next open redoes it from the log
+  if (!writePages(file_, dirty_)) {
+    if (error) *error = QString("Cannot write %1: %2").arg(path_, file_.errorString());
+    file_.close();
+    wal_.close();
+    opened_ = false;
+    cache_.clear();
+    dirty_.clear();
+    header_ = committedHeader_ = Header{};
+    return false;
+  }
+  wal_.resize(0);
+
+  for (auto it = dirty_.constBegin(); it != dirty_.constEnd(); ++it) cache_.insert(it.key(), new QByteArray(*it));
+  dirty_.clear();
+  committedHeader_ = header_;
+  return true;
+}
+
+void PagedStore::rollback() {
+  dirty_.clear();
+  header_ = committedHeader_;
+}
+
+QVector<quint32> PagedStore::chainPages(quint32 head) {
+  QVector<quint32> pages;
+  // Bounded by the page count, so a damaged link cannot loop forever
+  for (quint32 no = head; no != 0 && no < header_.pageCount && quint32(pages.size()) < header_.pageCount;
+       no = get<quint32>(page(no).constData())) {
+    pages.push_back(no);
+  }
+  return pages;
+}
+
+QByteArray PagedStore::readChain(quint32 head) {
+  QByteArray out;
+  for (const quint32 no : chainPages(head)) {
+    const QByteArray p = page(no);
+    const qsizetype used = std::min<qsizetype>(get<quint32>(p.constData() + 4), kChainPayload);
+    out.append(p.constData() + 2 * sizeof(quint32), used);
+  }
+  return out;
+}
+
+quint32 PagedStore::writeChain(quint32 head, const QByteArray& bytes) {
+  QVector<quint32> pages = chainPages(head);
+  const qsizetype needed = std::max<qsizetype>(1, (bytes.size() + kChainPayload - 1) / kChainPayload);
+  while (pages.size() > needed) release(pages.takeLast());
+  while (pages.size() < needed) pages.push_back(allocate());
+
+  for (qsizetype i = 0; i < needed; ++i) {
+    const qsizetype from = i * kChainPayload;
+    const qsizetype used = std::min(kChainPayload, bytes.size() - from);
+    QByteArray p(kPageSize, '\0');
+    set<quint32>(p, 0, i + 1 < needed ? pages[i + 1] : 0);
+    set<quint32>(p, 4, quint32(used));
+    if (used > 0) std::memcpy(p.data() + 2 * sizeof(quint32), bytes.constData() + from, size_t(used));
+    put(pages[i], p);
+  }
+  return pages.first();
+}
+
+void PagedStore::releaseChain(quint32 head) {
+  for (const quint32 no : chainPages(head)) release(no);
+}
+
+QMap<QString, quint32> PagedStore::readCatalog() {
+  QMap<QString, quint32> catalog;
+  if (header_.catalog == 0) return catalog;
+  QDataStream in(readChain(header_.catalog));
+  in >> catalog;
+  return catalog;
+}
+
+void PagedStore::writeCatalog(const QMap<QString, quint32>& catalog) {
+  QByteArray bytes;
+  QDataStream out(&bytes, QIODevice::WriteOnly);
+  out << catalog;
+  header_.catalog = writeChain(header_.catalog, bytes);
+}
+
+PagedStore::Meta PagedStore::readMeta(quint32 head) {
+  Meta m;
+  QDataStream in(readChain(head));
+  in >> m.headers >> m.rows >> m.directory >> m.dataPages >> m.tail >> m.generation >> m.liveBytes >> m.deadBytes;
+  return m;
+}
+
+quint32 PagedStore::writeMeta(quint32 head, const Meta& m) {
+  QByteArray bytes;
+  QDataStream out(&bytes, QIODevice::WriteOnly);
+  out << m.headers << m.rows << m.directory << m.dataPages << m.tail << m.generation << m.liveBytes << m.deadBytes;
+  return writeChain(head, bytes);
+}
+
+// Appended to the table's last data page, or a new one; big rows get a chain of their own
+quint64 PagedStore::storeRecord(Meta& meta, QVector<quint32>& dataPages, const QByteArray& record) {
+  meta.liveBytes += record.size();
+  if (record.size() > kBigRecord) return locator(writeChain(0, record), kChainSlot);
+
+  QByteArray p;
+  quint16 slots = 0;
+  quint16 start = 0;
+  if (meta.tail != 0) {
+    p = page(meta.tail);
+    slots = get<quint16>(p.constData());
+    start = get<quint16>(p.constData() + 2);
+  }
+  if (meta.tail == 0 || slots == kChainSlot - 1 || start - (kDataHeader + (slots + 1) * kSlotBytes) < record.size()) {
+    meta.tail = allocate();
+    dataPages.push_back(meta.tail);
+    p = QByteArray(kPageSize, '\0');
+    slots = 0;
+    start = quint16(kPageSize);
+  }
+
+  start -= quint16(record.size());
+  std::memcpy(p.data() + start, record.constData(), size_t(record.size()));
+  set<quint16>(p, kDataHeader + slots * kSlotBytes, start);
+  set<quint16>(p, kDataHeader + slots * kSlotBytes + 2, quint16(record.size()));
+  set<quint16>(p, 0, quint16(slots + 1));
+  set<quint16>(p, 2, start);
+  put(meta.tail, p);
+  return locator(meta.tail, slots);
+}
+
+QByteArray PagedStore::readRecord(quint64 loc) {
+  if (locatorSlot(loc) == kChainSlot) return readChain(locatorPage(loc));
+
+  const QByteArray p = page(locatorPage(loc));
+  const quint16 slot = locatorSlot(loc);
+  if (slot >= get<quint16>(p.constData())) return {};
+  const quint16 offset = get<quint16>(p.constData() + kDataHeader + slot * kSlotBytes);
+  const quint16 len = get<quint16>(p.constData() + kDataHeader + slot * kSlotBytes + 2);
+  if (offset + len > kPageSize) return {};
+  return p.mid(offset, len);
+}
+
+// Inline records stay where they are until the table is rewritten; chains are freed now
+void PagedStore::dropRecord(Meta& meta, quint64 loc) {
+  const quint64 bytes = quint64(readRecord(loc).size());
+  meta.liveBytes -= std::min(meta.liveBytes, bytes);
+  if (locatorSlot(loc) == kChainSlot) releaseChain(locatorPage(loc));
+  else meta.deadBytes += bytes;
+}
+
+bool PagedStore::writeTable(const QString& name, const QStringList& headers, int rows, const CellText& cell, QString* error,
+                            QVector<quint64>* locators) {
+  QMap<QString, quint32> catalog = readCatalog();
+  const quint32 metaHead = catalog.value(name);
+
+  Meta meta;
+  if (metaHead != 0) {
+    // Everything the table had goes back to the free list
+    const Meta old = readMeta(metaHead);
+    for (const quint64 loc : decodeLocators(readChain(old.directory), old.rows)) {
+      if (locatorSlot(loc) == kChainSlot) releaseChain(locatorPage(loc));
+    }
+    for (const quint32 no : decodePages(readChain(old.dataPages))) release(no);
+    releaseChain(old.directory);
+    releaseChain(old.dataPages);
+    meta.generation = old.generation + 1;
+  }
+
+  meta.headers = headers;
+  meta.rows = quint32(rows);
+  QVector<quint32> dataPages;
+  QByteArray directory;
+  directory.reserve(qsizetype(rows) * sizeof(quint64));
+  QStringList cells;
+  for (int r = 0; r < rows; ++r) {
+    cells.clear();
+    for (int c = 0; c < headers.size(); ++c) cells << cell(r, c);
+    const quint64 loc = storeRecord(meta, dataPages, encodeRecord(cells));
+    append<quint64>(directory, loc);
+    if (locators) locators->push_back(loc);
+  }
+  meta.directory = writeChain(0, directory);
+  meta.dataPages = writeChain(0, encodePages(dataPages));
+
+  catalog.insert(name, writeMeta(metaHead, meta));
+  writeCatalog(catalog);
+  return commit(error);
+}
+
+bool PagedStore::hasTable(const QString& name) {
+  QMutexLocker lock(&mutex_);
+  return open(nullptr) && readCatalog().contains(name);
+}
+
+std::shared_ptr<const CsvBackingStore> PagedStore::load(const QString& name, QString* error) {
+  QMutexLocker lock(&mutex_);
+  if (!open(error)) return nullptr;
+
+  const quint32 metaHead = readCatalog().value(name);
+  if (metaHead == 0) {
+    if (error) *error = QString("No table %1 in %2").arg(name, path_);
+    return nullptr;
+  }
+
+  const Meta meta = readMeta(metaHead);
+  QVector<quint64> locators = decodeLocators(readChain(meta.directory), meta.rows);
+  QVector<QStringList> rows;
+  rows.reserve(locators.size());
+  for (const quint64 loc : std::as_const(locators)) rows.push_back(decodeRecord(readRecord(loc)));
+
+  return std::make_shared<PagedTableStore>(this, name, meta.generation,
+                                           ColumnarCsvStore::fromRows(meta.headers, rows), std::move(locators));
+}
+
+// Whole table from the snapshot; remembers where each row went for the next save
+bool PagedStore::rewrite(const QString& name, const CsvTableModel::Snapshot& snap, QString* error) {
+  written_.remove(name);
+  QVector<quint64> rowLocators;
+  rowLocators.reserve(snap.rowCount());
+  const CellText cellText = [&snap](int r, int c) { return snap.cellText(r, c); };
+  if (!writeTable(name, snap.headers, snap.rowCount(), cellText, error, &rowLocators)) return false;
+  if (!snap.store) return true;
+
+  Written next;
+  next.base = snap.store;
+  next.generation = readMeta(readCatalog().value(name)).generation;
+  next.colIds = snap.colIds;
+  next.locators.resize(rowIdLimit(snap));
+  const QSet<int> edited = editedRows(snap);
+  const int baseRows = snap.store->rowCount();
+  for (int r = 0; r < snap.rowCount(); ++r) {
+    const int id = snap.rowIds[r];
+    next.locators[id] = rowLocators[r];
+    if (id >= baseRows || edited.contains(id)) next.records.insert(id, rowRecord(snap, r));
+  }
+  written_.insert(name, std::move(next));
+  return true;
+}
+
+bool PagedStore::save(const QString& name, const CsvTableModel::Snapshot& snap, QString* error) {
+  QMutexLocker lock(&mutex_);
+  if (!open(error)) return false;
+
+  // A store that is gone (table closed or reloaded) is never saved from again
+  for (auto it = written_.begin(); it != written_.end();) it = it->base.expired() ? written_.erase(it) : std::next(it);
+
+  QMap<QString, quint32> catalog = readCatalog();
+  const quint32 metaHead = catalog.value(name);
+  if (metaHead == 0 || !snap.store) return rewrite(name, snap, error);
+
+  // Where the rows of snap.store are on file: as the last save from it left them, else as loaded
+  Written prev;
+  const auto last = written_.constFind(name);
+  const auto* loaded = dynamic_cast<const PagedTableStore*>(snap.store.get());
+  if (last != written_.cend() && last->base.lock() == snap.store) {
+    prev = *last;
+  } else if (loaded && loaded->owner() == this && loaded->name() == name) {
+    prev.generation = loaded->generation();
+    for (int c = 0; c < loaded->columnCount(); ++c) prev.colIds << c;
+    prev.locators = loaded->locators();
+  } else {
+    return rewrite(name, snap, error);
+  }
+
+  // Row records can only be kept while the file still holds them and the columns are the same
+  Meta meta = readMeta(metaHead);
+  if (meta.generation != prev.generation || snap.headers != meta.headers || snap.colIds != prev.colIds) {
+    return rewrite(name, snap, error);
+  }
+
+  const QSet<int> edited = editedRows(snap);
+  const QVector<quint64> current = decodeLocators(readChain(meta.directory), meta.rows);
+  const QSet<quint64> stored(current.cbegin(), current.cend());
+  QVector<quint32> dataPages = decodePages(readChain(meta.dataPages));
+
+  Written next;
+  next.base = snap.store;
+  next.generation = meta.generation;
+  next.colIds = snap.colIds;
+  next.locators.resize(rowIdLimit(snap));
+  const int baseRows = snap.store->rowCount();
+
+  QSet<quint64> kept;
+  QByteArray directory;
+  directory.reserve(qsizetype(snap.rowCount()) * sizeof(quint64));
+  for (int r = 0; r < snap.rowCount(); ++r) {
+    const int id = snap.rowIds[r];
+    const bool fromBase = id < baseRows && !edited.contains(id);
+    const auto written = prev.records.constFind(id);
+
+    // A row read from the store is on file as it is, unless an earlier save put an edit there;
+    // any other row is compared with what was written for it
+    QByteArray record;
+    bool encoded = false;
+    bool same = fromBase && written == prev.records.cend();
+    if (!same) {
+      record = rowRecord(snap, r);
+      encoded = true;
+      same = written != prev.records.cend() && *written == record;
+    }
+
+    quint64 loc = id < prev.locators.size() ? prev.locators[id] : 0;
+    if (same && stored.contains(loc)) {
+      kept.insert(loc);
+    } else {
+      if (!encoded) record = rowRecord(snap, r);
+      loc = storeRecord(meta, dataPages, record);
+    }
+    append<quint64>(directory, loc);
+    next.locators[id] = loc;
+    if (!fromBase) next.records.insert(id, record);
+  }
+
+  // Records the new directory no longer points at: removed rows, earlier versions of edited ones
+  for (const quint64 loc : current) {
+    if (!kept.contains(loc)) dropRecord(meta, loc);
+  }
+
+  if (meta.deadBytes > std::max(meta.liveBytes, kMinDeadBytes)) {
+    rollback();
+    return rewrite(name, snap, error);
+  }
+
+  meta.rows = quint32(snap.rowCount());
+  meta.directory = writeChain(meta.directory, directory);
+  meta.dataPages = writeChain(meta.dataPages, encodePages(dataPages));
+  catalog.insert(name, writeMeta(metaHead, meta));
+  writeCatalog(catalog);
+  if (!commit(error)) {
+    // The log may still be redone on the next open: nothing known about the file is safe to reuse
+    written_.insert(name, Written{snap.store, ~quint64(0)});
+    return false;
+  }
+  written_.insert(name, std::move(next));
+  return true;
+}
+
+bool PagedStore::import(const QString& name, const CsvBackingStore& store, QString* error) {
+  QMutexLocker lock(&mutex_);
+  if (!open(error)) return false;
+  written_.remove(name);
+  return writeTable(name, store.headers(), store.rowCount(),
+                    [&store](int r, int c) { return store.cell(r, c); }, error);
+}
@@ -0,0 +1,64 @@
+#include "RowFilterJob.hpp"
+
+#include <QCoreApplication>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Rows per shard: small enough that a cancelled job stops within a few milliseconds.
+// A multiple of 8, so every shard's bits start on a byte and are copied in one go.
+constexpr int kShardRows = 16384;
+
+struct Shard {
+  int from = 0;
+  int to = 0;
+  QBitArray accepted;
+  QVector<quint8> scores;
+};
+
+} // namespace
+
+RowFilterJob::RowFilterJob(QObject* context, Callback onDone)
+  : context_(context), onDone_(std::move(onDone)) {}
+
+std::shared_ptr<RowFilterJob> RowFilterJob::start(CsvTableModel::Snapshot snap, RowQuery query, QBitArray mask,
+                                                  QObject* context, Callback onDone) {
+  std::shared_ptr<RowFilterJob> job(new RowFilterJob(context, std::move(onDone)));
+  (void)QtConcurrent::run([job, snap = std::move(snap), query = std::move(query), mask = std::move(mask)] {
+    job->run(snap, query, mask);
+  });
+  return job;
+}
+
+void RowFilterJob::run(const CsvTableModel::Snapshot& snap, const RowQuery& query, const QBitArray& mask) {
+  const int rows = snap.rowCount();
+
+  QVector<Shard> shards;
+  for (int from = 0; from < rows; from += kShardRows) shards.push_back({from, std::min(rows, from + kShardRows), {}});
+
+  QtConcurrent::blockingMap(shards, [&](Shard& s) {
+    if (!cancelled_) s.accepted = query.evaluate(snap, s.from, s.to, mask, query.isFuzzy() ? &s.scores : nullptr);
+  });
+  if (cancelled_) return;
+
+  QByteArray bits((rows + 7) / 8, '\0');
+  for (const Shard& s : std::as_const(shards)) {
+    std::memcpy(bits.data() + s.from / 8, s.accepted.bits(), size_t((s.to - s.from + 7) / 8));
+  }
+  const QBitArray accepted = QBitArray::fromBits(bits.constData(), rows);
+
+  QVector<quint8> scores;
+  if (query.isFuzzy()) {
+    scores.reserve(rows);
+    for (const Shard& s : std::as_const(shards)) scores += s.scores;
+  }
+
+  auto self = shared_from_this();
+  QMetaObject::invokeMethod(QCoreApplication::instance(), [self, accepted, scores] {
+    if (!self->cancelled_ && self->context_) self->onDone_(accepted, scores);
+  }, Qt::QueuedConnection);
+}
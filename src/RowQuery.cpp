@@ -0,0 +1,210 @@
+#include "RowQuery.hpp"
+#include "FuzzyMatcher.hpp"
+
+#include <QHash>
+#include <QRegularExpression>
+
+#include <algorithm>
+
+// Splits on whitespace outside double quotes; quotes stay in the token so an operator
+// inside a quoted value is never taken for one
+static QStringList splitTerms(const QString& text) {
+  QStringList out;
+  QString cur;
+  bool quoted = false;
+  for (const QChar ch : text) {
+    if (ch == '"') quoted = !quoted;
+    if (ch.isSpace() && !quoted) {
+      if (!cur.isEmpty()) out.push_back(cur);
+      cur.clear();
+      continue;
+    }
+    cur += ch;
+  }
+  if (!cur.isEmpty()) out.push_back(cur);
+  return out;
+}
+
+static QString unquote(QString s) {
+  s.remove('"');
+  return s;
+}
+
+RowQuery RowQuery::parse(const QString& text, const CsvTableModel& model, bool fuzzy) {
+  const QStringList headers = model.headers();
+  auto findColumn = [&](const QString& name) {
+    const QString key = name.trimmed().toLower();
+    for (int c = 0; c < headers.size(); ++c) {
+      if (headers[c].trimmed().toLower() == key) return c;
+    }
+    return -1;
+  };
+
+  static const QRegularExpression opChar(R"([:<>=!])");
+  RowQuery q;
+  QVector<Term> words;
+  for (const QString& token : splitTerms(text)) {
+    Term t;
+    const qsizetype at = token.indexOf(opChar);
+    if (at > 0 && !token.left(at).contains('"')) t.col = findColumn(token.left(at));
+
+    if (t.col >= 0) {
+      qsizetype valueAt = at + 1;
+      const QChar c0 = token[at];
+      const bool eq = at + 1 < token.size() && token[at + 1] == '=';
+      if (c0 == ':') t.op = Op::Contains;
+      else if (c0 == '=') t.op = Op::Equals;
+      else if (c0 == '!' && eq) t.op = Op::NotEquals;
+      else if (c0 == '<') t.op = eq ? Op::LessEq : Op::Less;
+      else if (c0 == '>') t.op = eq ? Op::GreaterEq : Op::Greater;
+      else t.col = -1;
+      if ((c0 == '!' || c0 == '<' || c0 == '>') && eq) ++valueAt;
+      t.text = unquote(token.mid(valueAt));
+
+      // Ranges only make sense on numeric columns; equality there compares values ("80" = "80.0")
+      const bool range = t.op != Op::Contains && t.op != Op::Equals && t.op != Op::NotEquals;
+      const bool numericCol = model.columnType(t.col) == CsvTableModel::ColumnType::Numeric;
+      const bool isNumber = CsvTableModel::parseNumber(t.text, t.number);
+      if (t.op != Op::Contains && numericCol && isNumber) t.numeric = true;
+      else if (range) t.col = -1;
+    }
+
+    if (t.col < 0) {
+      // Unknown column or nonsense comparison: the token is an ordinary search word
+      Term word;
+      word.text = unquote(token);
+      if (!word.text.isEmpty()) words.push_back(word);
+      continue;
+    }
+    q.terms_.push_back(t);
+  }
+
+  if (q.terms_.isEmpty()) {
+    // Plain text: one substring over all columns, spaces and quotes included, unless the quotes
+    // enclose all of it
+    const QString trimmed = text.trimmed();
+    const bool quoted = trimmed.size() >= 2 && trimmed.startsWith('"') && trimmed.endsWith('"');
+    const QString plain = quoted ? trimmed.mid(1, trimmed.size() - 2) : text;
+    if (!plain.isEmpty()) q.terms_.push_back(Term{-1, Op::Contains, false, 0.0, plain});
+  } else {
+    q.plain_ = false;
+    q.terms_ += words;
+  }
+
+  // Fuzzy mode: text searches tolerate a few typos; short or very long text stays exact
+  for (Term& t : q.terms_) {
+    if (!fuzzy || t.op != Op::Contains) continue;
+    auto matcher = std::make_shared<const FuzzyMatcher>(t.text);
+    const int limit = FuzzyMatcher::defaultLimit(matcher->length());
+    if (!matcher->isValid() || limit == 0) continue;
+    t.fuzzy = std::move(matcher);
+    t.maxErrors = limit;
+    q.fuzzy_ = true;
+  }
+
+  std::stable_sort(q.terms_.begin(), q.terms_.end(),
+                   [](const Term& a, const Term& b) { return cost(a) < cost(b); });
+  return q;
+}
+
+QString RowQuery::plainText() const {
+  return plain_ && !terms_.isEmpty() ? terms_.first().text : QString();
+}
+
+bool RowQuery::candidates(const CsvTableModel& model, QVector<int>& rows) const {
+  // Only an exact substring has to contain every trigram of its text
+  if (!plain_ || fuzzy_ || terms_.isEmpty()) return false;
+  return model.searchCandidates(terms_.first().text, rows);
+}
+
+int RowQuery::cost(const Term& t) {
+  if (t.numeric) return 0;    // typed value, usually straight from the store
+  if (t.fuzzy) return t.col >= 0 ? 2 : 4;
+  if (t.col >= 0) return 1;   // one cell's text
+  return 3;                   // every cell's text
+}
+
+int RowQuery::score(const Term& t, const QString& cell) {
+  if (t.fuzzy) {
+    const int d = t.fuzzy->distance(cell, t.maxErrors);
+    return d <= t.maxErrors ? d : -1;
+  }
+  return matches(t, cell) ? 0 : -1;
+}
+
+bool RowQuery::matches(const Term& t, const QString& cell) {
+  switch (t.op) {
+    case Op::Contains: return cell.contains(t.text, Qt::CaseInsensitive);
+    case Op::Equals: return cell.trimmed().compare(t.text, Qt::CaseInsensitive) == 0;
+    case Op::NotEquals: return cell.trimmed().compare(t.text, Qt::CaseInsensitive) != 0;
+    default: return false;
+  }
+}
+
+bool RowQuery::matchesNumber(const Term& t, double v) {
+  switch (t.op) {
+    case Op::Equals: return v == t.number;
+    case Op::NotEquals: return v != t.number;
+    case Op::Less: return v < t.number;
+    case Op::LessEq: return v <= t.number;
+    case Op::Greater: return v > t.number;
+    case Op::GreaterEq: return v >= t.number;
+    default: return false;
+  }
+}
+
+QBitArray RowQuery::evaluate(const CsvTableModel::Snapshot& snap, int from, int to, const QBitArray& mask,
+                             QVector<quint8>* scores) const {
+  const int cols = snap.columnCount();
+  QBitArray alive(to - from, true);
+  qsizetype left = to - from;
+  if (scores) scores->fill(0, to - from);
+  if (!mask.isEmpty()) {
+    for (int r = from; r < to; ++r) {
+      if (r < mask.size() && mask.testBit(r)) continue;
+      alive.clearBit(r - from);
+      --left;
+    }
+  }
+
+  for (const Term& t : terms_) {
+    if (left == 0) break;
+
+    // Encoded columns: each distinct value is tested once, then rows look up their code
+    QHash<int, QVector<qint16>> byCode; // column -> per code: -2 unknown, -1 no match, else errors
+    auto cellScore = [&](int row, int col) {
+      const int code = snap.dictionaryCode(row, col);
+      if (code < 0) return score(t, snap.cellText(row, col));
+      QVector<qint16>& known = byCode[col];
+      if (known.isEmpty()) known.fill(-2, snap.dictionary(col)->size());
+      if (known[code] == -2) known[code] = qint16(score(t, snap.dictionary(col)->at(code)));
+      return int(known[code]);
+    };
+
+    for (int r = from; r < to; ++r) {
+      if (!alive.testBit(r - from)) continue;
+
+      int best = -1;
+      if (t.numeric) {
+        double v = 0.0;
+        if (t.col < cols && snap.cellNumber(r, t.col, v) && matchesNumber(t, v)) best = 0; // empty cells never match
+      } else if (t.col >= 0) {
+        if (t.col < cols) best = cellScore(r, t.col);
+      } else {
+        for (int c = 0; c < cols && best != 0; ++c) {
+          const int s = cellScore(r, c);
+          if (s >= 0 && (best < 0 || s < best)) best = s;
+        }
+      }
+
+      if (best < 0) {
+        alive.clearBit(r - from);
+        --left;
+      } else if (scores && best > 0) {
+        quint8& total = (*scores)[r - from];
+        total = quint8(std::min(255, total + best));
+      }
+    }
+  }
+  return alive;
+}
@@ -0,0 +1,199 @@
+#include "TableSchema.hpp"
+
+#include <QBitArray>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// One column's rule, resolved against the header row, plus what checking it found
+struct ColumnCheck {
+  int col = -1;
+  TableSchema::Rule rule;
+  bool numeric = false;
+  QSet<QString> allowed; // enum: case-folded values
+  QVector<TableSchema::Issue> issues;
+};
+
+TableSchema::Type parseType(const QString& name) {
+  const QString t = name.trimmed().toLower();
+  if (t == "int" || t == "integer") return TableSchema::Type::Int;
+  if (t == "float" || t == "double" || t == "number") return TableSchema::Type::Float;
+  if (t == "enum") return TableSchema::Type::Enum;
+  return TableSchema::Type::Text;
+}
+
+QString numberText(double v) {
+  return QString::number(v, 'g', 15);
+}
+
+// Why a value breaks the type or range, empty when it passes
+QString checkNumber(const ColumnCheck& c, double v) {
+  if (c.rule.type == TableSchema::Type::Int && v != std::trunc(v)) return "not a whole number";
+  if (c.rule.hasMin && v < c.rule.min) return "below the minimum " + numberText(c.rule.min);
+  if (c.rule.hasMax && v > c.rule.max) return "above the maximum " + numberText(c.rule.max);
+  return {};
+}
+
+QString checkText(const ColumnCheck& c, const QString& text) {
+  const QString trimmed = text.trimmed();
+  if (trimmed.isEmpty()) return c.rule.required ? QString("required value is empty") : QString();
+
+  switch (c.rule.type) {
+    case TableSchema::Type::Int:
+    case TableSchema::Type::Float: {
+      double v = 0.0;
+      if (!CsvTableModel::parseNumber(trimmed, v)) return "not a number";
+      return checkNumber(c, v);
+    }
+    case TableSchema::Type::Enum:
+      if (!c.allowed.contains(trimmed.toCaseFolded())) return "not one of " + c.rule.values.join(", ");
+      return {};
+    case TableSchema::Type::Text:
+      return {};
+  }
+  return {};
+}
+
+void checkColumn(ColumnCheck& c, const CsvTableModel::Snapshot& snap) {
+  const int rows = snap.rowCount();
+
+  // Encoded columns: each distinct value is checked once, then rows look up their code
+  const QStringList* dict = snap.dictionary(c.col);
+  QVector<QString> reasonByCode;
+  QBitArray knownCode;
+  if (dict) {
+    reasonByCode.resize(dict->size());
+    knownCode.resize(dict->size());
+  }
+  QSet<QString> seen; // unique: trimmed text of the rows so far
+
+  for (int r = 0; r < rows; ++r) {
+    QString reason;
+    double v = 0.0;
+    const int code = dict ? snap.dictionaryCode(r, c.col) : -1;
+    if (code >= 0) {
+      if (!knownCode.testBit(code)) {
+        reasonByCode[code] = checkText(c, dict->at(code));
+        knownCode.setBit(code);
+      }
+      reason = reasonByCode[code];
+    } else if (c.numeric && snap.cellNumber(r, c.col, v)) {
+      reason = checkNumber(c, v); // typed columns never go through text
+    } else {
+      reason = checkText(c, snap.cellText(r, c.col));
+    }
+
+    if (reason.isEmpty() && c.rule.unique) {
+      const QString key = snap.cellText(r, c.col).trimmed();
+      if (!key.isEmpty()) {
+        // Named by value, not row: rows may move before the report is read
+        if (seen.contains(key)) reason = QString("\"%1\" is not unique").arg(key);
+        else seen.insert(key);
+      }
+    }
+
+    if (reason.isEmpty()) continue;
+    c.issues.push_back({r, c.col, reason, snap.rowIds[r]});
+    if (c.issues.size() >= TableSchema::kMaxIssuesPerColumn) break;
+  }
+}
+
+} // namespace
+
+QString TableSchema::pathFor(const QString& csvPath) {
+  return csvPath + ".schema.json";
+}
+
+TableSchema TableSchema::load(const QString& csvPath) {
+  TableSchema schema;
+
+  QFile f(pathFor(csvPath));
+  if (!f.open(QIODevice::ReadOnly)) return schema;
+
+  const QJsonDocument doc = QJsonDocument::fromJson(f.readAll());
+  if (!doc.isObject()) return schema;
+  schema.doc_ = doc.object();
+
+  for (const auto& v : schema.doc_.value("numeric").toArray()) schema.numeric_.insert(v.toString().trimmed().toLower());
+
+  const QJsonObject columns = schema.doc_.value("columns").toObject();
+  for (auto it = columns.constBegin(); it != columns.constEnd(); ++it) {
+    const QJsonObject o = it.value().toObject();
+    Rule r;
+    r.type = parseType(o.value("type").toString());
+    r.required = o.value("required").toBool();
+    r.unique = o.value("unique").toBool();
+    r.hasMin = o.value("min").isDouble();
+    r.hasMax = o.value("max").isDouble();
+    r.min = o.value("min").toDouble();
+    r.max = o.value("max").toDouble();
+    for (const auto& v : o.value("values").toArray()) r.values << v.toString().trimmed();
+    schema.rules_.insert(it.key().trimmed().toLower(), r);
+  }
+  return schema;
+}
+
+bool TableSchema::save(const QString& csvPath) const {
+  QStringList keys(numeric_.cbegin(), numeric_.cend());
+  keys.sort(); // stable file content, so unchanged schemas do not show up as changes
+  QJsonObject obj = doc_;
+  obj["numeric"] = QJsonArray::fromStringList(keys);
+
+  QSaveFile f(pathFor(csvPath));
+  if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+  f.write(QJsonDocument(obj).toJson(QJsonDocument::Indented));
+  return f.commit();
+}
+
+QSet<QString> TableSchema::numericColumns() const {
+  QSet<QString> out = numeric_;
+  for (auto it = rules_.constBegin(); it != rules_.constEnd(); ++it) {
+    if (it->type == Type::Int || it->type == Type::Float) out.insert(it.key());
+  }
+  return out;
+}
+
+void TableSchema::setNumericColumns(const QSet<QString>& colsLower) {
+  // Columns numeric only through an int/float rule stay out of the list, so removing the rule
+  // later makes them text again
+  QSet<QString> listed;
+  for (const auto& s : colsLower) {
+    const QString key = s.trimmed().toLower();
+    const auto rule = rules_.constFind(key);
+    const bool byRule = rule != rules_.constEnd() && (rule->type == Type::Int || rule->type == Type::Float);
+    if (!byRule || numeric_.contains(key)) listed.insert(key);
+  }
+  numeric_ = listed;
+}
+
+QVector<TableSchema::Issue> TableSchema::validate(const CsvTableModel::Snapshot& snap) const {
+  // Compile: one check per column that has a rule, resolved once for the whole table
+  QVector<ColumnCheck> checks;
+  for (int c = 0; c < snap.columnCount(); ++c) {
+    const auto it = rules_.constFind(snap.headers.value(c).trimmed().toLower());
+    if (it == rules_.constEnd()) continue;
+
+    ColumnCheck check;
+    check.col = c;
+    check.rule = *it;
+    check.numeric = it->type == Type::Int || it->type == Type::Float;
+    for (const auto& v : it->values) check.allowed.insert(v.toCaseFolded());
+    checks.push_back(check);
+  }
+
+  QtConcurrent::blockingMap(checks, [&snap](ColumnCheck& c) { checkColumn(c, snap); });
+
+  QVector<Issue> issues;
+  for (const ColumnCheck& c : std::as_const(checks)) issues += c.issues;
+  std::sort(issues.begin(), issues.end(), [](const Issue& a, const Issue& b) {
+    return a.row != b.row ? a.row < b.row : a.col < b.col;
+  });
+  return issues;
+}
@@ -0,0 +1,122 @@
+#include "TableStorage.hpp"
+#include "AdminDbPaths.hpp"
+#include "CsvBackingStore.hpp"
+#include "CsvCache.hpp"
+#include "CsvWriter.hpp"
+#include "EditJournal.hpp"
+#include "PagedStore.hpp"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace {
+
+class CsvFileStorage : public TableStorage {
+public:
+  std::shared_ptr<CsvLoadJob> startLoad(const QString& csvPath, QObject* context, CsvLoadJob::Callback onUpdate) override {
+    return CsvLoadJob::start(csvPath, context, std::move(onUpdate));
+  }
+
+  std::shared_ptr<const CsvBackingStore> load(const QString& csvPath, QString* error) override {
+    return CsvLoadJob::loadNow(csvPath, error);
+  }
+
+  bool save(const QString& csvPath, const CsvTableModel::Snapshot& snap, QString* error, qint64 journalMark) override {
+    // Write to a temp file and rename: a crash mid-write leaves the old file intact,
+    // and the model may still be reading a mapping of `csvPath`
+    QSaveFile f(csvPath);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Text)) {
+      if (error) *error = "Cannot write: " + csvPath;
+      return false;
+    }
+
+    // Cells stream from the snapshot into one reusable UTF-8 block
+    CsvWriter out(&f);
+    snap.visitCells(out);
+    if (!out.flush() || !f.flush()) {
+      if (error) *error = "Cannot write: " + csvPath;
+      return false;
+    }
+
+    if (journalMark >= 0) {
+      // The journal learns the new file's size and mtime before the rename, so whichever CSV a
+      // crash leaves in place gets exactly the records it lacks
+      qint64 stamp = QDateTime::currentSecsSinceEpoch() * 1000;
+      if (stamp == QFileInfo(csvPath).lastModified().toMSecsSinceEpoch()) stamp += 1000;
+      if (!f.setFileTime(QDateTime::fromMSecsSinceEpoch(stamp), QFileDevice::FileModificationTime) ||
+          !EditJournal::prepareRebase(csvPath, journalMark, f.size(), stamp)) {
+        f.cancelWriting();
+        if (error) *error = "Cannot write: " + EditJournal::journalPathFor(csvPath);
+        return false;
+      }
+    }
+
+    if (!f.commit()) {
+      if (error) *error = "Cannot write: " + csvPath;
+      return false;
+    }
+    if (journalMark >= 0) EditJournal::rebase(csvPath, journalMark);
+
+    CsvCache::rebuildInBackground(csvPath);
+    return true;
+  }
+
+  bool usesCsvFiles() const override { return true; }
+};
+
+class PagedStorage : public TableStorage {
+public:
+  std::shared_ptr<CsvLoadJob> startLoad(const QString& csvPath, QObject* context, CsvLoadJob::Callback onUpdate) override {
+    return CsvLoadJob::startWith([this, csvPath](QString* error) { return load(csvPath, error); },
+                                 context, std::move(onUpdate));
+  }
+
+  std::shared_ptr<const CsvBackingStore> load(const QString& csvPath, QString* error) override {
+    const QString name = tableName(csvPath);
+    if (!store_.hasTable(name)) {
+      // First use: the table comes from its CSV, if there is one, with the edits journaled
+      // against that CSV while it was the table
+      QString csvError;
+      const auto csv = CsvLoadJob::loadNow(csvPath, &csvError);
+      if (!csv) {
+        if (error) *error = csvError;
+        return nullptr;
+      }
+
+      const QVector<EditJournal::Record> records = EditJournal::readCommitted(csvPath);
+      if (records.isEmpty()) {
+        if (!store_.import(name, *csv, error)) return nullptr;
+      } else {
+        CsvTableModel model;
+        model.setStore(csv);
+        EditJournal::apply(model, records);
+        if (!store_.save(name, model.snapshot(), error)) return nullptr;
+      }
+      EditJournal::discard(csvPath); // in the paged file now; the CSV is left as it was
+    }
+    return store_.load(name, error);
+  }
+
+  bool save(const QString& csvPath, const CsvTableModel::Snapshot& snap, QString* error, qint64) override {
+    return store_.save(tableName(csvPath), snap, error);
+  }
+
+  bool usesCsvFiles() const override { return false; }
+
+private:
+  static QString tableName(const QString& csvPath) { return QFileInfo(csvPath).fileName(); } // "material.csv"
+
+  PagedStore store_{AdminDbPaths::pagedStorePath()};
+};
+
+} // namespace
+
+TableStorage& TableStorage::instance() {
+#ifdef PBADMIN_PAGED_STORAGE
+  static PagedStorage storage;
+#else
+  static CsvFileStorage storage;
+#endif
+  return storage;
+}
@@ -0,0 +1,110 @@
+#include "TrigramIndex.hpp"
+#include "CsvBackingStore.hpp"
+
+#include <QThread>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+
+namespace {
+
+constexpr int kBuildSlices = 8; // per thread, for load balance
+
+// Three UTF-16 units packed into one key
+inline quint64 packTrigram(const QChar* p) {
+  return (quint64(p[0].unicode()) << 32) | (quint64(p[1].unicode()) << 16) | quint64(p[2].unicode());
+}
+
+void sortUnique(QVector<quint64>& v) {
+  std::sort(v.begin(), v.end());
+  v.erase(std::unique(v.begin(), v.end()), v.end());
+}
+
+} // namespace
+
+void TrigramIndex::appendTrigrams(QStringView folded, QVector<quint64>& out) {
+  for (qsizetype i = 0; i + kGram <= folded.size(); ++i) out.push_back(packTrigram(folded.data() + i));
+}
+
+std::shared_ptr<TrigramIndex> TrigramIndex::build(const CsvBackingStore& store) {
+  const int rows = store.rowCount();
+  const int cols = store.columnCount();
+
+  const int sliceCount = std::max(1, std::min(rows, QThread::idealThreadCount() * kBuildSlices));
+  struct Slice {
+    int from = 0;
+    int to = 0;
+    QHash<quint64, QVector<int>> postings;
+  };
+  QVector<Slice> slices(sliceCount);
+  for (int i = 0; i < sliceCount; ++i) {
+    slices[i].from = int(qint64(rows) * i / sliceCount);
+    slices[i].to = int(qint64(rows) * (i + 1) / sliceCount);
+  }
+
+  QtConcurrent::blockingMap(slices, [&store, cols](Slice& s) {
+    QVector<quint64> grams;
+    for (int r = s.from; r < s.to; ++r) {
+      grams.clear();
+      for (int c = 0; c < cols; ++c) appendTrigrams(store.cell(r, c).toCaseFolded(), grams);
+      sortUnique(grams);
+      for (const quint64 g : grams) s.postings[g].push_back(r);
+    }
+  });
+
+  // Slices are in row order, so appending keeps every posting list ascending
+  auto index = std::make_shared<TrigramIndex>();
+  for (const Slice& s : slices) {
+    for (auto it = s.postings.cbegin(); it != s.postings.cend(); ++it) index->postings_[it.key()].append(it.value());
+  }
+  return index;
+}
+
+void TrigramIndex::add(int rowId, QStringView text) {
+  QVector<quint64> grams;
+  appendTrigrams(text.toString().toCaseFolded(), grams);
+  sortUnique(grams);
+
+  for (const quint64 g : grams) {
+    QVector<int>& list = postings_[g];
+    const auto at = std::lower_bound(list.begin(), list.end(), rowId);
+    if (at == list.end() || *at != rowId) list.insert(at, rowId);
+  }
+}
+
+qint64 TrigramIndex::memoryBytes() const {
+  qint64 bytes = 0;
+  for (const QVector<int>& list : postings_) bytes += 48 + list.capacity() * qint64(sizeof(int)); // 48: hash node
+  return bytes;
+}
+
+QVector<int> TrigramIndex::candidates(QStringView needle) const {
+  QVector<quint64> grams;
+  appendTrigrams(needle.toString().toCaseFolded(), grams);
+  sortUnique(grams);
+
+  // Intersect from the rarest trigram up; each step only probes the survivors
+  QVector<const QVector<int>*> lists;
+  for (const quint64 g : grams) {
+    const auto it = postings_.constFind(g);
+    if (it == postings_.constEnd()) return {};
+    lists.push_back(&*it);
+  }
+  if (lists.isEmpty()) return {};
+  std::sort(lists.begin(), lists.end(), [](auto* a, auto* b) { return a->size() < b->size(); });
+
+  QVector<int> result = *lists.first();
+  for (qsizetype i = 1; i < lists.size() && !result.isEmpty(); ++i) {
+    const QVector<int>& list = *lists[i];
+    auto from = list.cbegin();
+    QVector<int> kept;
+    kept.reserve(result.size());
+    for (const int id : std::as_const(result)) {
+      from = std::lower_bound(from, list.cend(), id);
+      if (from == list.cend()) break;
+      if (*from == id) kept.push_back(id);
+    }
+    result = std::move(kept);
+  }
+  return result;
+}
@@ -0,0 +1,151 @@
+// CsvTokenizer (64-byte SIMD blocks, parallel chunks) against the serial reader it replaced:
+// CsvUtils::readCsvRecord + parseCsvRecord over a text-mode QTextStream, blank records skipped.
+// Both record paths are checked: tokenize() (loaded tables) and indexRecords() (mapped files).
+#include "CsvTokenizer.hpp"
+#include "CsvUtils.hpp"
+
+#include <QBuffer>
+#include <QByteArray>
+#include <QStringList>
+#include <QTextStream>
+#include <QVector>
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <random>
+
+namespace {
+
+using Table = QVector<QStringList>;
+
+Table readSerial(const QByteArray& bytes) {
+  QBuffer buf;
+  buf.setData(bytes);
+  buf.open(QIODevice::ReadOnly | QIODevice::Text);
+  QTextStream in(&buf);
+  in.setEncoding(QStringConverter::Utf8);
+
+  Table records;
+  while (!in.atEnd()) {
+    const QString rec = CsvUtils::readCsvRecord(in);
+    if (rec.isNull() || rec.trimmed().isEmpty()) continue;
+    records.push_back(CsvUtils::parseCsvRecord(rec));
+  }
+  return records;
+}
+
+Table readTokenized(const QByteArray& bytes) {
+  const CsvTokenizer::Index idx = CsvTokenizer::tokenize(bytes.constData(), bytes.size());
+  Table records;
+  for (qsizetype r = 0; r < idx.recordCount(); ++r) records.push_back(CsvTokenizer::decodeRecord(bytes.constData(), idx, r));
+  return records;
+}
+
+Table readIndexed(const QByteArray& bytes) {
+  Table records;
+  for (const auto& rec : CsvTokenizer::indexRecords(bytes.constData(), bytes.size())) {
+    records.push_back(CsvTokenizer::splitRecord(bytes.constData(), rec));
+  }
+  return records;
+}
+
+QByteArray quoted(const QStringList& fields) {
+  return fields.join(", ").toUtf8().replace('\n', "\\n").replace('\r', "\\r").left(200);
+}
+
+int failures = 0;
+
+void compare(const char* name, const char* path, const Table& expected, const Table& actual) {
+  if (expected == actual) return;
+  ++failures;
+  std::fprintf(stderr, "FAIL %s (%s): %lld records, expected %lld\n", name, path,
+               static_cast<long long>(actual.size()), static_cast<long long>(expected.size()));
+  for (qsizetype r = 0; r < std::min(expected.size(), actual.size()); ++r) {
+    if (expected[r] == actual[r]) continue;
+    std::fprintf(stderr, "  first difference at record %lld\n    expected: %s\n    actual:   %s\n",
+                 static_cast<long long>(r), quoted(expected[r]).constData(), quoted(actual[r]).constData());
+    break;
+  }
+}
+
+void check(const char* name, const QByteArray& bytes) {
+  const Table expected = readSerial(bytes);
+  compare(name, "tokenize", expected, readTokenized(bytes));
+  compare(name, "indexRecords", expected, readIndexed(bytes));
+}
+
+// Bytes drawn from the characters the tokenizer treats specially, plus filler
+QByteArray soup(std::mt19937& rng, int length) {
+  static const char kAlphabet[] = {'a', 'b', ' ', ',', ',', '"', '"', '\n', '\r'};
+  std::uniform_int_distribution<int> pick(0, int(sizeof(kAlphabet)) - 1);
+  QByteArray out;
+  for (int i = 0; i < length; ++i) out += kAlphabet[pick(rng)];
+  return out;
+}
+
+// Well-formed records whose quoted fields hold commas, "" escapes, LF, CRLF and lone CRs,
+// some long enough to run across chunk boundaries
+QByteArray document(std::mt19937& rng, qsizetype minBytes) {
+  std::uniform_int_distribution<int> percent(0, 99);
+  std::uniform_int_distribution<int> shortLen(0, 12);
+  std::uniform_int_distribution<int> longLen(1000, 200000);
+  const char* kInside[] = {"x", "y z", ",", "\"\"", "\n", "\r\n", "\r", "é"};
+  std::uniform_int_distribution<int> inside(0, int(std::size(kInside)) - 1);
+
+  QByteArray out;
+  while (out.size() < minBytes) {
+    const int fields = 1 + shortLen(rng) % 6;
+    for (int f = 0; f < fields; ++f) {
+      if (f > 0) out += ',';
+      const int kind = percent(rng);
+      if (kind < 50) {
+        out += QByteArray(shortLen(rng), 'p');
+      } else {
+        const int len = kind < 52 ? longLen(rng) : shortLen(rng);
+        out += '"';
+        for (int i = 0; i < len; ++i) out += kInside[inside(rng)];
+        out += '"';
+      }
+    }
+    const int end = percent(rng);
+    out += end < 60 ? "\n" : end < 85 ? "\r\n" : end < 95 ? "\n\n" : "\r\n \r\n";
+  }
+  return out;
+}
+
+} // namespace
+
+int main() {
+  check("empty", "");
+  check("header only", "a,b,c");
+  check("no final newline", "a,b\nc,d");
+  check("blank lines", "\n\n  \na,b\n \t\n\nc,d\n\n");
+  check("escaped quotes", "\"he said \"\"hi\"\"\",\"\"\"\"\n\"\",x\n");
+  check("quoted separators", "\"a,b\",\"c\nd\",\"e\r\nf\"\ng,h\n");
+  check("crlf", "a,b\r\nc,d\r\n\r\ne,f");
+  check("lone cr", "a\rb,c\n\"d\re\",f\rg\n\r\n");
+  check("quote at block edge", QByteArray(63, 'a') + "\"" + QByteArray(70, ',') + "\"\n" + QByteArray(64, 'b') + "\n");
+  check("cr at block edge", QByteArray(63, 'a') + "\r\n" + QByteArray(62, 'b') + "\r\r\n");
+  check("unterminated quote", "a,b\n\"c,d\ne,f\n");
+  check("unterminated quote, crlf", "a,b\r\n\"c\r\n\r\n");
+
+  std::mt19937 rng(20261017);
+  for (int i = 0; i < 3000; ++i) check("soup", soup(rng, i % 300));
+
+  // Past the parallel threshold (4 MiB): split into chunks wherever there is more than one core
+  for (int i = 0; i < 3; ++i) {
+    QByteArray doc = document(rng, 9 * 1024 * 1024);
+    check("chunked document", doc);
+    doc.chop(1); // last record without its newline
+    check("chunked document, no final newline", doc);
+  }
+
+  // One quoted field spanning several chunks: later chunks start inside quotes
+  const QByteArray longQuoted = "h1,h2\nx,\"" + QByteArray(6 * 1024 * 1024, 'q').replace(1000, 3, "\n,\"\"") + "\",y\nz,w\n";
+  check("quote across chunks", longQuoted);
+  check("chunked soup", soup(rng, 6 * 1024 * 1024));
+
+  if (failures == 0) std::printf("CsvTokenizer matches the serial reader\n");
+  return failures == 0 ? 0 : 1;
+}